@@ -0,0 +1,75 @@
+#ifndef ACTIVE_HPP
+#define ACTIVE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//
+// active tile tracking: the inner board is cut in tiles and a tile is
+// recomputed only if it or one of its 8 neighbours changed in the previous
+// generation. A skipped tile needs no copy: its cells in the future buffer
+// are those of two generations ago, which equal the current ones since the
+// tile has not changed since.
+//
+// Workers record whether each tile they compute changed, the emitter calls
+// schedule() at the start of every generation and the drain advance() at
+// its end.
+//
+class tile_activity {
+   private:
+    long n_rows, n_cols;       // board
+    long tile_rows, tile_cols;
+    long tiles_r, tiles_c;     // tiles per column and per row
+    // changed in the previous generation / in the current one, one byte
+    // per tile so that workers never write the same word
+    std::vector<uint8_t> changed, next_changed;
+    std::vector<int> active;   // tiles to compute in this generation
+
+   public:
+    tile_activity(long rows, long cols, long tile_rows, long tile_cols)
+        : n_rows(rows), n_cols(cols),
+          tile_rows(tile_rows), tile_cols(tile_cols),
+          tiles_r((rows - 2 + tile_rows - 1) / tile_rows),
+          tiles_c((cols - 2 + tile_cols - 1) / tile_cols),
+          changed(tiles_r * tiles_c, 1), next_changed(changed.size(), 0) {}
+
+    size_t tiles() const { return changed.size(); }
+    size_t n_active() const { return active.size(); }
+    int active_tile(size_t i) const { return active[i]; }
+
+    // cells of tile t: rows [r0, r1) and columns [c0, c1)
+    void bounds(int t, long &r0, long &r1, long &c0, long &c1) const {
+        r0 = 1 + (t / tiles_c) * tile_rows;
+        c0 = 1 + (t % tiles_c) * tile_cols;
+        r1 = std::min(r0 + tile_rows, n_rows - 1);
+        c1 = std::min(c0 + tile_cols, n_cols - 1);
+    }
+
+    // called by the worker computing tile t
+    void mark(int t, bool tile_changed) { next_changed[t] = tile_changed; }
+
+    // the tiles changed in the previous generation and their neighbours
+    void schedule() {
+        active.clear();
+        for (long tr = 0; tr < tiles_r; ++tr)
+            for (long tc = 0; tc < tiles_c; ++tc) {
+                bool dirty = false;
+                for (long i = std::max(0L, tr - 1);
+                     !dirty && i <= std::min(tiles_r - 1, tr + 1); ++i)
+                    for (long j = std::max(0L, tc - 1);
+                         j <= std::min(tiles_c - 1, tc + 1); ++j)
+                        dirty |= changed[i * tiles_c + j];
+                if (dirty)
+                    active.push_back(tr * tiles_c + tc);
+            }
+    }
+
+    // end of generation: skipped tiles did not change
+    void advance() {
+        changed.swap(next_changed);
+        std::fill(next_changed.begin(), next_changed.end(), 0);
+    }
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef BARRIER_HPP
+#define BARRIER_HPP
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// reusable barriers for a fixed set of n threads, numbered 0 to n-1. A
+// barrier can run a completion step (e.g. swapping the boards) on one of
+// the threads after all have arrived and before any leaves:
+//
+//   central       one counter and a sense flag reversed at every episode
+//   tree          counters of at most 4 threads each, combined up a tree,
+//                 so that no counter is hit by more than 4 threads
+//   dissemination log2(n) rounds of pairwise flags, no shared counter
+//
+// Waiting threads spin for a while, then either sleep on a futex or keep
+// yielding, as the wait_policy says.
+//
+
+struct wait_policy {
+    int spins = 1024;  // before sleeping or yielding
+    bool futex = true; // or yield
+};
+
+// a word threads wait on for a change of value
+class alignas(64) event_word {
+   private:
+    std::atomic<uint32_t> value;
+    std::atomic<uint32_t> sleepers;
+
+    void futex_wait(uint32_t old) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&value),
+                FUTEX_WAIT_PRIVATE, old, nullptr, nullptr, 0);
+    }
+
+    void futex_wake() {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&value),
+                FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+    }
+
+   public:
+    event_word() : value(0), sleepers(0) {}
+
+    uint32_t load() const { return value.load(std::memory_order_acquire); }
+
+    // until the value is not old; sleepers and value are seq_cst on both
+    // sides, so either the storer sees the sleeper or the sleeper sees the
+    // new value
+    void await(uint32_t old, const wait_policy &policy) {
+        for (int spins = 0; spins < policy.spins; ++spins)
+            if (load() != old)
+                return;
+        if (!policy.futex) {
+            while (load() == old)
+                std::this_thread::yield();
+            return;
+        }
+        while (value.load() == old) {
+            sleepers.fetch_add(1);
+            if (value.load() == old)
+                futex_wait(old);
+            sleepers.fetch_sub(1);
+        }
+    }
+
+    void store(uint32_t v) {
+        value.store(v);
+        if (sleepers.load() > 0)
+            futex_wake();
+    }
+};
+
+class thread_barrier {
+   public:
+    virtual ~thread_barrier() {}
+
+    // true for exactly one thread, once all have arrived: that thread runs
+    // the completion step and then calls release(), the others return
+    // false after it
+    virtual bool arrive(int id) = 0;
+    virtual void release(int id) = 0;
+
+    // a barrier with no completion step
+    virtual void wait(int id) {
+        if (arrive(id))
+            release(id);
+    }
+
+    template <typename F>
+    void wait(int id, F completion) {
+        if (arrive(id)) {
+            completion();
+            release(id);
+        }
+    }
+};
+
+// per thread state, a cache line each
+struct alignas(64) barrier_local {
+    uint32_t sense = 0;
+    uint32_t episode = 0;
+};
+
+class central_barrier : public thread_barrier {
+   private:
+    const int n;
+    const wait_policy policy;
+    alignas(64) std::atomic<int> count;
+    event_word sense;
+    std::vector<barrier_local> local;
+
+   public:
+    central_barrier(int n, wait_policy policy = wait_policy())
+        : n(n), policy(policy), count(0), local(n) {}
+
+    bool arrive(int id) override {
+        const uint32_t mine = local[id].sense ^= 1;
+        if (count.fetch_add(1, std::memory_order_acq_rel) == n - 1) {
+            // nobody arrives again before the release
+            count.store(0, std::memory_order_relaxed);
+            return true;
+        }
+        sense.await(mine ^ 1, policy);
+        return false;
+    }
+
+    void release(int id) override { sense.store(local[id].sense); }
+};
+
+class tree_barrier : public thread_barrier {
+   private:
+    static constexpr int FAN_IN = 4;
+
+    struct alignas(64) node {
+        std::atomic<int> count{0};
+        int expected = 0;
+        int parent = -1;
+    };
+
+    const wait_policy policy;
+    std::vector<node> nodes; // leaves first, root last
+    event_word sense;
+    std::vector<barrier_local> local;
+
+   public:
+    tree_barrier(int n, wait_policy policy = wait_policy())
+        : policy(policy), local(n) {
+        int total = 0;
+        for (int level = n; level > 1 || total == 0;) {
+            level = (level + FAN_IN - 1) / FAN_IN;
+            total += level;
+        }
+        nodes = std::vector<node>(total);
+        // thread i arrives at node i / FAN_IN, node k of a level at node
+        // k / FAN_IN of the next one
+        for (int base = 0, children = n; base < total;) {
+            const int level = (children + FAN_IN - 1) / FAN_IN;
+            for (int k = 0; k < level; ++k) {
+                nodes[base + k].expected =
+                    std::min(FAN_IN, children - k * FAN_IN);
+                if (level > 1)
+                    nodes[base + k].parent = base + level + k / FAN_IN;
+            }
+            base += level;
+            children = level;
+        }
+    }
+
+    bool arrive(int id) override {
+        const uint32_t mine = local[id].sense ^= 1;
+        // the last thread at a node goes on to its parent
+        for (int k = id / FAN_IN; k >= 0; k = nodes[k].parent) {
+            node &at = nodes[k];
+            if (at.count.fetch_add(1, std::memory_order_acq_rel) !=
+                at.expected - 1) {
+                sense.await(mine ^ 1, policy);
+                return false;
+            }
+            at.count.store(0, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    void release(int id) override { sense.store(local[id].sense); }
+};
+
+class dissemination_barrier : public thread_barrier {
+   private:
+    const int n;
+    const wait_policy policy;
+    int rounds;
+    // flags[i * rounds + r]: the last episode thread i was signalled in
+    // round r, by thread i - 2^r
+    std::vector<event_word> flags;
+    event_word released; // episode, by thread 0 after the completion
+    std::vector<barrier_local> local;
+
+    // until word reaches episode e; the signaller may already be in e + 1
+    void await_episode(event_word &word, uint32_t e) {
+        uint32_t v;
+        while (int32_t((v = word.load()) - e) < 0)
+            word.await(v, policy);
+    }
+
+    void disseminate(int id, uint32_t e) {
+        for (int r = 0; r < rounds; ++r) {
+            flags[((id + (1 << r)) % n) * rounds + r].store(e);
+            await_episode(flags[id * rounds + r], e);
+        }
+    }
+
+   public:
+    dissemination_barrier(int n, wait_policy policy = wait_policy())
+        : n(n), policy(policy), rounds(0), local(n) {
+        while ((1 << rounds) < n)
+            ++rounds;
+        flags = std::vector<event_word>(n * rounds);
+    }
+
+    // thread 0 runs the completion, the others wait for its release
+    bool arrive(int id) override {
+        const uint32_t e = ++local[id].episode;
+        disseminate(id, e);
+        if (id == 0)
+            return true;
+        await_episode(released, e);
+        return false;
+    }
+
+    void release(int id) override { released.store(local[id].episode); }
+
+    using thread_barrier::wait;
+
+    // no step, no release to wait for
+    void wait(int id) override { disseminate(id, ++local[id].episode); }
+};
+
+// "central", "tree" or "dissemination", nullptr for anything else
+inline std::unique_ptr<thread_barrier>
+make_barrier(const std::string &kind, int n,
+             wait_policy policy = wait_policy()) {
+    if (kind == "central")
+        return std::unique_ptr<thread_barrier>(new central_barrier(n, policy));
+    if (kind == "tree")
+        return std::unique_ptr<thread_barrier>(new tree_barrier(n, policy));
+    if (kind == "dissemination")
+        return std::unique_ptr<thread_barrier>(
+            new dissemination_barrier(n, policy));
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// neighbour count of 64 cells, one bit per cell for each binary digit
+struct slices {
+    uint64_t s0, s1, s2, s3;
+};
+
+// full adder working on 64 independent cells at once
+static inline void full_add(uint64_t a, uint64_t b, uint64_t c,
+                            uint64_t &sum, uint64_t &carry) {
+    uint64_t t = a ^ b;
+    sum = t ^ c;
+    carry = (a & b) | (t & c);
+}
+
+// sums the 8 neighbour masks of 64 cells: u* is the row above, m* the
+// same row, d* the row below; l/r are the left and right neighbours
+static inline slices count_neighbours(uint64_t ul, uint64_t u, uint64_t ur,
+                                      uint64_t ml, uint64_t mr,
+                                      uint64_t dl, uint64_t d, uint64_t dr) {
+    uint64_t ua, ub, ma, mb, da, db;
+    full_add(ul, u, ur, ua, ub); // row above: 0..3
+    ma = ml ^ mr;                // same row: 0..2
+    mb = ml & mr;
+    full_add(dl, d, dr, da, db); // row below: 0..3
+
+    // weight 1
+    uint64_t ones, c1;
+    full_add(ua, ma, da, ones, c1);
+    // weight 2: ub + mb + db + c1
+    uint64_t t0, t1;
+    full_add(ub, mb, db, t0, t1);
+    uint64_t twos = t0 ^ c1, t2 = t0 & c1;
+    // weight 4 and 8
+    return {ones, twos, t1 ^ t2, t1 & t2};
+}
+
+// B3/S23: alive with 3 neighbours, or with 2 if already alive
+static inline uint64_t life_rule(const slices &n, uint64_t alive) {
+    return ~n.s3 & ~n.s2 & n.s1 & (n.s0 | alive);
+}
+
+// board packing 64 cells per word: cell j of a row is bit j % 64 of word
+// j / 64. As for the vector boards, rows 0 and rows-1, columns 0 and cols-1
+// are the dead border and are never written by step()
+class bitboard {
+   private:
+    size_t n_rows, n_cols, n_words;
+    std::vector<uint64_t> cells;
+    std::vector<uint64_t> mask; // inner columns of each word
+
+   public:
+    bitboard() : n_rows(0), n_cols(0), n_words(0) {}
+
+    bitboard(size_t rows, size_t cols)
+        : n_rows(rows), n_cols(cols), n_words((cols + 63) / 64),
+          cells(rows * n_words, 0), mask(n_words, 0) {
+        for (size_t j = 1; j + 1 < cols; ++j)
+            mask[j / 64] |= uint64_t(1) << (j % 64);
+    }
+
+    // number of rows, as vector<vector<T>>::size()
+    size_t size() const { return n_rows; }
+    size_t rows() const { return n_rows; }
+    size_t cols() const { return n_cols; }
+    size_t words() const { return n_words; }
+    uint64_t inner_mask(size_t k) const { return mask[k]; }
+
+    uint64_t *row(size_t i) { return cells.data() + i * n_words; }
+    const uint64_t *row(size_t i) const { return cells.data() + i * n_words; }
+
+    bool get(size_t i, size_t j) const {
+        return (row(i)[j / 64] >> (j % 64)) & 1;
+    }
+
+    void set(size_t i, size_t j, bool alive) {
+        uint64_t bit = uint64_t(1) << (j % 64);
+        if (alive)
+            row(i)[j / 64] |= bit;
+        else
+            row(i)[j / 64] &= ~bit;
+    }
+
+    void swap(bitboard &other) {
+        std::swap(n_rows, other.n_rows);
+        std::swap(n_cols, other.n_cols);
+        std::swap(n_words, other.n_words);
+        cells.swap(other.cells);
+        mask.swap(other.mask);
+    }
+
+    // computes rows [from, to) of future, 64 cells per iteration
+    void step(bitboard &future, size_t from, size_t to) const {
+        const size_t last = n_words - 1;
+        for (size_t i = from; i < to; ++i) {
+            const uint64_t *up = row(i - 1), *mid = row(i), *down = row(i + 1);
+            uint64_t *out = future.row(i);
+            for (size_t k = 0; k < n_words; ++k) {
+                // neighbours crossing the word boundary come from the
+                // adjacent words of the same row
+                uint64_t u = up[k], m = mid[k], d = down[k];
+                uint64_t ul = (u << 1) | (k > 0 ? up[k - 1] >> 63 : 0);
+                uint64_t ur = (u >> 1) | (k < last ? up[k + 1] << 63 : 0);
+                uint64_t ml = (m << 1) | (k > 0 ? mid[k - 1] >> 63 : 0);
+                uint64_t mr = (m >> 1) | (k < last ? mid[k + 1] << 63 : 0);
+                uint64_t dl = (d << 1) | (k > 0 ? down[k - 1] >> 63 : 0);
+                uint64_t dr = (d >> 1) | (k < last ? down[k + 1] << 63 : 0);
+                slices n = count_neighbours(ul, u, ur, ml, mr, dl, d, dr);
+                out[k] = life_rule(n, m) & mask[k];
+            }
+        }
+    }
+};
+
+inline void swap(bitboard &a, bitboard &b) { a.swap(b); }
+
+#endif
@@ -0,0 +1,297 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "grid.hpp"
+#include "options.hpp"
+#include "patterns.hpp"
+#include "record.hpp"
+
+//
+// checkpoint/restart: every --checkpoint-every generations the board is
+// packed 64 cells per word (the bitboard layout) into a snapshot buffer,
+// and a background thread compresses it and writes it to --checkpoint,
+// through a temporary file renamed once complete. The compute threads only
+// pay for the packing; when the writer is still busy with the previous
+// snapshot, a newer one replaces the snapshot waiting for it instead of
+// waiting. The board the run ends with is the last checkpoint, written
+// before the checkpointer goes.
+//
+// --resume maps a checkpoint file and restarts from its generation: the
+// drivers then run the generations still missing.
+//
+// --record=file keeps every generation computed, see record.hpp; it rides
+// on the ticks, so any driver that checkpoints can record.
+//
+
+struct checkpoint_header {
+    char magic[8];        // GOLCKPT1
+    uint64_t rows, cols;  // whole board, border included
+    uint64_t generation;
+    int64_t seed;
+    uint64_t raw_bytes;   // packed board
+    uint64_t stored_bytes; // payload following the header
+    uint64_t compressed;
+};
+
+class checkpointer {
+   private:
+    static constexpr char MAGIC[9] = "GOLCKPT1";
+
+    std::string path, resume;
+    unsigned long every, stride;
+    unsigned long generation; // of the board given to tick()
+    int seed;
+    bool compress;
+
+    // packed by tick(), then swapped with the snapshot handed to the
+    // writer, which swaps it out in turn
+    std::vector<uint64_t> fresh, snap;
+    uint64_t snap_rows, snap_cols;
+    unsigned long snap_generation;
+    unsigned long taken; // generation of the last snapshot, -1 for none
+    bool pending, stop;
+    unsigned long replaced;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::thread writer;
+
+    std::unique_ptr<recorder> history;
+
+    template <typename T>
+    static void wrap(Grid<T> &board) { board.wrap(); }
+    static void wrap(bitboard &) {}
+
+    // hands board over to the writer, replacing the snapshot still
+    // waiting for it if any
+    template <typename BOARD>
+    void snapshot(const BOARD &board) {
+        fresh.resize(board.rows() * ((board.cols() + 63) / 64));
+        pack_board(board, fresh.data());
+        {
+            std::unique_lock<std::mutex> l(lock);
+            if (pending)
+                ++replaced;
+            fresh.swap(snap);
+            snap_rows = board.rows();
+            snap_cols = board.cols();
+            snap_generation = generation;
+            pending = true;
+        }
+        taken = generation;
+        cv.notify_one();
+    }
+
+    bool write(const std::vector<uint64_t> &raw, uint64_t rows,
+               uint64_t cols, unsigned long g) {
+        checkpoint_header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, MAGIC, sizeof(h.magic));
+        h.rows = rows;
+        h.cols = cols;
+        h.generation = g;
+        h.seed = seed;
+        h.raw_bytes = raw.size() * sizeof(uint64_t);
+        const unsigned char *payload =
+            reinterpret_cast<const unsigned char *>(raw.data());
+        h.stored_bytes = h.raw_bytes;
+
+#ifdef GOL_MINIZ
+        std::vector<unsigned char> packed;
+        if (compress) {
+            mz_ulong len = mz_compressBound(h.raw_bytes);
+            packed.resize(len);
+            if (mz_compress2(packed.data(), &len, payload, h.raw_bytes,
+                             MZ_BEST_SPEED) != MZ_OK) {
+                std::cout << "Checkpoint compression failed" << std::endl;
+                return false;
+            }
+            payload = packed.data();
+            h.stored_bytes = len;
+            h.compressed = 1;
+        }
+#endif
+
+        const std::string tmp = path + ".tmp";
+        FILE *f = fopen(tmp.c_str(), "wb");
+        if (f == nullptr) {
+            std::cout << "Failed opening " << tmp << std::endl;
+            return false;
+        }
+        bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                  fwrite(payload, 1, h.stored_bytes, f) == h.stored_bytes &&
+                  fflush(f) == 0 && fsync(fileno(f)) == 0;
+        ok = fclose(f) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            std::cout << "Failed writing checkpoint " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void write_loop() {
+        std::vector<uint64_t> raw;
+        std::unique_lock<std::mutex> l(lock);
+        while (true) {
+            cv.wait(l, [this] { return pending || stop; });
+            if (!pending)
+                return;
+            raw.swap(snap);
+            const uint64_t rows = snap_rows, cols = snap_cols;
+            const unsigned long g = snap_generation;
+            pending = false;
+            l.unlock();
+            write(raw, rows, cols, g);
+            l.lock();
+        }
+    }
+
+   public:
+    // --checkpoint=file --checkpoint-every=N [--compress] [--resume=file]
+    // [--record=file --keyframe-every=K]
+    checkpointer(const options &opts, int seed)
+        : path(opts.get("checkpoint", "")), resume(opts.get("resume", "")),
+          every(opts.get("checkpoint-every", 1000L)), stride(1),
+          generation(0), seed(seed), compress(opts.has("compress")),
+          snap_rows(0), snap_cols(0), snap_generation(0), taken(-1),
+          pending(false), stop(false), replaced(0) {
+#ifndef GOL_MINIZ
+        if (compress)
+            std::cout << "Built without GOL_MINIZ, checkpoints are not "
+                         "compressed" << std::endl;
+        compress = false;
+#endif
+        if (!path.empty() && every > 0)
+            writer = std::thread(&checkpointer::write_loop, this);
+        if (opts.has("record"))
+            history.reset(new recorder(opts.get("record", ""),
+                                       opts.get("keyframe-every", 64L), seed,
+                                       compress));
+    }
+
+    // waits for the last snapshot to be written
+    ~checkpointer() {
+        if (!writer.joinable())
+            return;
+        {
+            std::unique_lock<std::mutex> l(lock);
+            stop = true;
+        }
+        cv.notify_one();
+        writer.join();
+        if (replaced > 0)
+            std::cout << replaced << " checkpoints replaced by newer ones,"
+                      << " writer busy" << std::endl;
+    }
+
+    checkpointer(const checkpointer &) = delete;
+    checkpointer &operator=(const checkpointer &) = delete;
+
+    bool resuming() const { return !resume.empty(); }
+
+    // generations still to run out of the requested ones
+    unsigned long remaining(unsigned long generations) const {
+        return generation >= generations ? 0 : generations - generation;
+    }
+
+    // generations advanced by each tick()
+    void set_stride(unsigned long n) { stride = n; }
+
+    // loads the --resume checkpoint into board, of the same size; on a
+    // torus the halo is refreshed
+    template <typename BOARD>
+    bool restore(BOARD &board, bool torus = false) {
+        mapped_file file(resume);
+        checkpoint_header h;
+        if (!file.valid() || file.size() < sizeof(h)) {
+            std::cout << "Failed opening checkpoint " << resume << std::endl;
+            return false;
+        }
+        std::memcpy(&h, file.data(), sizeof(h));
+        if (std::memcmp(h.magic, MAGIC, sizeof(h.magic)) != 0 ||
+            file.size() < sizeof(h) + h.stored_bytes ||
+            h.raw_bytes != h.rows * ((h.cols + 63) / 64) * sizeof(uint64_t)) {
+            std::cout << "Not a valid checkpoint: " << resume << std::endl;
+            return false;
+        }
+        if (h.rows != uint64_t(board.rows()) ||
+            h.cols != uint64_t(board.cols())) {
+            std::cout << "Checkpoint board is " << h.rows << "x" << h.cols
+                      << ", not " << board.rows() << "x" << board.cols()
+                      << std::endl;
+            return false;
+        }
+
+        // uncompressed boards are unpacked straight from the mapping
+        const uint64_t *raw =
+            reinterpret_cast<const uint64_t *>(file.data() + sizeof(h));
+        std::vector<uint64_t> inflated;
+        if (h.compressed) {
+#ifdef GOL_MINIZ
+            inflated.resize(h.raw_bytes / sizeof(uint64_t));
+            mz_ulong len = h.raw_bytes;
+            if (mz_uncompress(
+                    reinterpret_cast<unsigned char *>(inflated.data()), &len,
+                    reinterpret_cast<const unsigned char *>(raw),
+                    h.stored_bytes) != MZ_OK ||
+                len != h.raw_bytes) {
+                std::cout << "Corrupted checkpoint " << resume << std::endl;
+                return false;
+            }
+            raw = inflated.data();
+#else
+            std::cout << "Compressed checkpoint, build with -DGOL_MINIZ"
+                      << std::endl;
+            return false;
+#endif
+        }
+        unpack_board(raw, board);
+        if (torus)
+            wrap(board);
+        generation = h.generation;
+        std::cout << "Resuming from generation " << generation << " (seed "
+                  << h.seed << ")" << std::endl;
+        return true;
+    }
+
+    // board as the simulation starts from it, initialized or restored:
+    // the first keyframe of a recording
+    template <typename BOARD>
+    void start(const BOARD &board) {
+        if (history)
+            history->tick(board, generation);
+    }
+
+    // end of a step of the simulation, board is the current state
+    template <typename BOARD>
+    void tick(const BOARD &board) {
+        const unsigned long before = generation;
+        generation += stride;
+        if (history)
+            history->tick(board, generation);
+        if (writer.joinable() && generation / every != before / every)
+            snapshot(board);
+    }
+
+    // the board the simulation ends with, unless tick() has just taken it
+    template <typename BOARD>
+    void finish(const BOARD &board) {
+        if (writer.joinable() && generation != taken)
+            snapshot(board);
+    }
+};
+
+#endif
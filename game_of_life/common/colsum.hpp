@@ -0,0 +1,103 @@
+#ifndef COLSUM_HPP
+#define COLSUM_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "grid.hpp"
+#include "random.hpp"
+
+//
+// column-sum neighbour counts, --kernel=colsum: the sums of the cells of
+// every column over rows i-1, i and i+1 are kept for the row being
+// computed, and the alive neighbours of cell j are
+//
+//   col[j-1] + col[j] + col[j+1] - cell
+//
+// 3 adds and a subtraction instead of 7 adds. Going down a run of rows the
+// sums are rolled, adding the row entering the window and subtracting the
+// one leaving it, so each column sum is shared by the 3 cells next to it
+// and by the 3 rows it spans. Both loops are plain element-wise ones over
+// T, vectorized like the direct count.
+//
+
+template <typename T>
+class column_sums {
+   private:
+    std::vector<T> sums; // column j at sums[j + 1], -1 <= j <= cols
+
+    T *columns(const Grid<T> &board) {
+        sums.resize(board.cols() + 2);
+        return sums.data() + 1;
+    }
+
+   public:
+    // the sums centred on row i, for the cells of columns [from, to)
+    const T *first(const Grid<T> &board, long i, long from, long to) {
+        T *__restrict s = columns(board);
+        const T *up = board[i - 1], *mid = board[i], *down = board[i + 1];
+        for (long j = from - 1; j < to + 1; ++j)
+            s[j] = up[j] + mid[j] + down[j];
+        return s;
+    }
+
+    // from the sums centred on row i-1, by the same first() or next() call
+    // sequence on the same board, to those centred on row i
+    const T *next(const Grid<T> &board, long i, long from, long to) {
+        T *__restrict s = sums.data() + 1;
+        const T *gone = board[i - 2], *down = board[i + 1];
+        for (long j = from - 1; j < to + 1; ++j)
+            s[j] += down[j] - gone[j];
+        return s;
+    }
+};
+
+// alive neighbours of cell j of the row with column sums col
+template <typename T>
+inline T colsum_neighbours(const T *col, const T *mid, long j) {
+    return col[j - 1] + col[j] + col[j + 1] - mid[j];
+}
+
+// --kernel=direct|colsum, false for anything else
+inline bool parse_kernel(const std::string &name, bool &colsum) {
+    colsum = name == "colsum";
+    return colsum || name == "direct";
+}
+
+// the column sums against the direct count, over every row of random
+// boards of a few sizes and densities, rolled down the whole board as a
+// worker does down its chunk
+template <typename T>
+inline bool colsum_self_check() {
+    const long sizes[][2] = {{3, 3}, {7, 40}, {33, 129}};
+    const double densities[] = {0.1, 0.5, 0.9};
+    column_sums<T> sums;
+    int seed = 1;
+    for (auto &size : sizes)
+        for (double density : densities) {
+            Grid<T> board(size[0], size[1], 1);
+            const cell_random rng(seed++, density);
+            for (long i = -1; i <= board.rows(); ++i)
+                for (long j = -1; j <= board.cols(); ++j)
+                    board[i][j] = rng.alive(
+                        uint64_t(i + 1) * (board.cols() + 2) + j + 1);
+            const long from = 0, to = board.cols();
+            for (long i = 0; i < board.rows(); ++i) {
+                const T *col = i == 0 ? sums.first(board, i, from, to)
+                                      : sums.next(board, i, from, to);
+                const T *up = board[i - 1], *mid = board[i],
+                        *down = board[i + 1];
+                for (long j = from; j < to; ++j) {
+                    const T direct = up[j - 1] + up[j] + up[j + 1] +
+                                     mid[j - 1] + mid[j + 1] +
+                                     down[j - 1] + down[j] + down[j + 1];
+                    if (colsum_neighbours(col, mid, j) != direct)
+                        return false;
+                }
+            }
+        }
+    return true;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef CYCLE_HPP
+#define CYCLE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "random.hpp"
+
+//
+// cycle detection on a Zobrist hash of the board: every cell has a random
+// 64-bit key and the hash is the XOR of the keys of the live cells, so a
+// generation changes it by the XOR of the keys of the cells that flipped,
+// whatever the order the chunks are combined in. The keys are a mix of the
+// cell index, nothing is stored.
+//
+// The hash is only known relative to the initial board, which is enough to
+// compare generations: a hash equal to the one p generations ago means a
+// cycle of period p, up to a collision of 64-bit hashes.
+//
+
+inline uint64_t zobrist_key(uint64_t cell) { return splitmix64(cell); }
+
+// XOR of the keys of the cells first + k, k < n, that differ between
+// before and after, with no branch so that the loop vectorizes. AVX2 has
+// no 64-bit multiply: in its clone the compiler emulates those of the keys
+// with 32-bit ones, 4 keys at a time, which still beats the scalar loop
+template <typename T>
+__attribute__((target_clones("avx2", "default")))
+uint64_t dense_flips(uint64_t first, const T *before, const T *after,
+                     long n) {
+    uint64_t flips = 0;
+    for (long k = 0; k < n; ++k)
+        flips ^= zobrist_key(first + k) & (0 - uint64_t(before[k] != after[k]));
+    return flips;
+}
+
+// the same, knowing that the block has changed cells: a few are found and
+// hashed one by one, stopping at the last, many all at once
+template <typename T>
+inline uint64_t block_flips(uint64_t first, const T *before, const T *after,
+                            long n, long changed) {
+    constexpr long FEW = 24;
+    if (changed > FEW)
+        return dense_flips(first, before, after, n);
+    uint64_t flips = 0;
+    for (long k = 0; changed > 0; ++k)
+        if (before[k] != after[k]) {
+            flips ^= zobrist_key(first + k);
+            --changed;
+        }
+    return flips;
+}
+
+// the hashes of the last max_period generations, in a ring
+class cycle_detector {
+   private:
+    int max_period;
+    std::vector<uint64_t> ring;
+    uint64_t hash;
+    unsigned long generation, generations;
+    bool extrapolate;
+    long left; // generations still to run once a cycle is found, -1 before
+
+   public:
+    // generations is the length of the run, reached by running the cycle
+    // to its phase at the end of the run if extrapolate
+    cycle_detector(int max_period = 0, unsigned long generations = 0,
+                   bool extrapolate = false)
+        : max_period(max_period), ring(max_period > 0 ? max_period : 0),
+          hash(0), generation(0), generations(generations),
+          extrapolate(extrapolate), left(-1) {}
+
+    bool enabled() const { return max_period > 0; }
+
+    // at the end of a generation, with the flips of all its cells: true
+    // when the run can stop
+    bool step(uint64_t flips) {
+        ++generation;
+        if (left >= 0)
+            return --left == 0;
+
+        const uint64_t next = hash ^ flips;
+        for (int p = 1; p <= max_period && p <= long(generation); ++p) {
+            const uint64_t before =
+                p == long(generation) ? 0 : ring[(generation - p) % max_period];
+            if (before != next)
+                continue;
+            std::cout << "Cycle of period " << p << " from generation "
+                      << generation - p << (p == 1 ? " (still life)" : "")
+                      << ", found at generation " << generation << std::endl;
+            left = extrapolate ? (generations - generation) % p : 0;
+            if (left > 0)
+                std::cout << "Running " << left
+                          << " more generations to the phase of generation "
+                          << generations << std::endl;
+            return left == 0;
+        }
+        hash = next;
+        ring[generation % max_period] = hash;
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+//
+// board stored in a single 64-byte aligned allocation, replacing
+// vector<vector<T>>: no pointer chasing per row and rows packed in memory.
+//
+// Cells are addressed as grid[i][j], 0 <= i < rows, 0 <= j < cols, plus a
+// halo of `halo` cells on each side reachable with negative indices or
+// indices past the end. The left halo is padded so that column 0 of every
+// row starts on a cache line, and the row stride is a multiple of the
+// cache line as well.
+//
+template <typename T>
+class Grid {
+   public:
+    static constexpr size_t CACHE_LINE = 64;
+
+   private:
+    long n_rows, n_cols, n_halo;
+    size_t row_stride; // in cells
+    size_t left;       // cells before column 0 in each row
+    T *cells;
+
+    static size_t round_up(size_t cells) {
+        size_t per_line = CACHE_LINE / sizeof(T);
+        return (cells + per_line - 1) / per_line * per_line;
+    }
+
+    size_t bytes() const {
+        return row_stride * (n_rows + 2 * n_halo) * sizeof(T);
+    }
+
+    void allocate() {
+        cells = static_cast<T *>(std::aligned_alloc(CACHE_LINE, bytes()));
+        if (cells == nullptr)
+            throw std::bad_alloc();
+    }
+
+   public:
+    Grid() : n_rows(0), n_cols(0), n_halo(0), row_stride(0), left(0),
+             cells(nullptr) {}
+
+    // all cells, halo included, start dead; with zero = false the memory
+    // is left untouched, for the owner threads to first-touch its rows
+    // with zero_rows()
+    Grid(long rows, long cols, long halo = 0, bool zero = true)
+        : n_rows(rows), n_cols(cols), n_halo(halo),
+          row_stride(round_up(round_up(halo) + cols + halo)),
+          left(round_up(halo)) {
+        allocate();
+        if (zero)
+            std::memset(static_cast<void *>(cells), 0, bytes());
+    }
+
+    Grid(const Grid &other)
+        : n_rows(other.n_rows), n_cols(other.n_cols), n_halo(other.n_halo),
+          row_stride(other.row_stride), left(other.left) {
+        allocate();
+        std::memcpy(static_cast<void *>(cells), other.cells, bytes());
+    }
+
+    Grid(Grid &&other) : Grid() { swap(other); }
+
+    Grid &operator=(Grid other) {
+        swap(other);
+        return *this;
+    }
+
+    ~Grid() { std::free(cells); }
+
+    void swap(Grid &other) {
+        std::swap(n_rows, other.n_rows);
+        std::swap(n_cols, other.n_cols);
+        std::swap(n_halo, other.n_halo);
+        std::swap(row_stride, other.row_stride);
+        std::swap(left, other.left);
+        std::swap(cells, other.cells);
+    }
+
+    // number of rows, as vector<vector<T>>::size()
+    size_t size() const { return n_rows; }
+    long rows() const { return n_rows; }
+    long cols() const { return n_cols; }
+    long halo() const { return n_halo; }
+    size_t stride() const { return row_stride; }
+
+    // pointer to column 0 of row i
+    T *operator[](long i) {
+        return cells + (i + n_halo) * row_stride + left;
+    }
+    const T *operator[](long i) const {
+        return cells + (i + n_halo) * row_stride + left;
+    }
+
+    // clears rows [from, to), -halo <= from <= to <= rows + halo, padding
+    // included
+    void zero_rows(long from, long to) {
+        std::memset(static_cast<void *>(cells + (from + n_halo) * row_stride),
+                    0, (to - from) * row_stride * sizeof(T));
+    }
+
+    // torus topology, needs a halo of at least one cell: refreshes the halo
+    // cells mirroring row i, i.e. its two column halo cells and, for the
+    // first and last row, the halo row on the opposite side (corners
+    // included). Only the owner of row i writes them.
+    void wrap_row(long i) {
+        T *r = (*this)[i];
+        r[-1] = r[n_cols - 1];
+        r[n_cols] = r[0];
+        if (i == 0)
+            std::memcpy(static_cast<void *>((*this)[n_rows] - 1), r - 1,
+                        (n_cols + 2) * sizeof(T));
+        if (i == n_rows - 1)
+            std::memcpy(static_cast<void *>((*this)[-1] - 1), r - 1,
+                        (n_cols + 2) * sizeof(T));
+    }
+
+    // refreshes the whole halo
+    void wrap() {
+        for (long i = 0; i < n_rows; ++i)
+            wrap_row(i);
+    }
+};
+
+template <typename T>
+inline void swap(Grid<T> &a, Grid<T> &b) { a.swap(b); }
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef INIT_HPP
+#define INIT_HPP
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "bitboard.hpp"
+#include "grid.hpp"
+#include "patterns.hpp"
+#include "random.hpp"
+#include "rules.hpp"
+
+//
+// initial board of the drivers: the pattern file given with --load=file,
+// or cells alive with probability density from the counter-based generator
+// keyed by seed, drawn by nw threads over bands of rows as the workers
+// split them, so that the rows are first touched there. On a torus there
+// is no dead border and the halo is refreshed once loaded.
+//
+
+// the drivers take the rule from --rule, not from the pattern
+inline void warn_rule(const pattern_info &info) {
+    rule_spec rule;
+    if (!parse_rule(info.rule, rule) || rule != life::spec)
+        std::cout << "Pattern written for " << info.rule
+                  << ", select the rule with --rule" << std::endl;
+}
+
+// rows [from, to) of a random board, columns [b, cols - b)
+template <typename T>
+inline void random_rows(Grid<T> &board, const cell_random &rng, long from,
+                        long to, long b) {
+    for (long i = from; i < to; ++i)
+        rng.fill(board[i], i * board.cols(), b, board.cols() - b);
+}
+
+template <typename T>
+inline bool init_board(Grid<T> &board, const std::string &load, int seed,
+                       bool torus, int nw, double density = 0.5) {
+    nw = std::max(nw, 1); // parallel_for() runs f(0) even for no thread
+    const long b = torus ? 0 : 1;
+    if (!load.empty()) {
+        pattern_info info;
+        if (!load_pattern(load, board, info, b, nw))
+            return false;
+        warn_rule(info);
+    } else {
+        const cell_random rng(seed, density);
+        const long rows = board.rows() - 2 * b;
+        parallel_for(nw, [&](int t) {
+            random_rows(board, rng, b + rows * t / nw,
+                        b + rows * (t + 1) / nw, b);
+        });
+    }
+    if (torus)
+        board.wrap();
+    return true;
+}
+
+inline bool init_board(bitboard &board, const std::string &load, int seed,
+                       int nw, double density = 0.5) {
+    nw = std::max(nw, 1);
+    if (!load.empty()) {
+        Grid<uint8_t> cells(board.rows(), board.cols());
+        pattern_info info;
+        if (!load_pattern(load, cells, info, 1, nw))
+            return false;
+        warn_rule(info);
+        for (long i = 1; i < cells.rows() - 1; ++i)
+            for (long j = 1; j < cells.cols() - 1; ++j)
+                board.set(i, j, cells[i][j]);
+    } else {
+        // a word at a time, the border masked out
+        const cell_random rng(seed, density);
+        const long rows = board.rows() - 2;
+        parallel_for(nw, [&](int t) {
+            for (long i = 1 + rows * t / nw; i < 1 + rows * (t + 1) / nw;
+                 ++i)
+                for (size_t k = 0; k < board.words(); ++k)
+                    board.row(i)[k] = rng.word(i * board.cols(), k * 64) &
+                                      board.inner_mask(k);
+        });
+    }
+    return true;
+}
+
+inline bool save_pattern(const std::string &path, const bitboard &board,
+                         const rule_spec &rule) {
+    Grid<uint8_t> cells(board.rows(), board.cols());
+    for (long i = 0; i < cells.rows(); ++i)
+        for (long j = 0; j < cells.cols(); ++j)
+            cells[i][j] = board.get(i, j);
+    return save_pattern(path, cells, rule);
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef LTL_HPP
+#define LTL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "grid.hpp"
+#include "patterns.hpp"
+#include "random.hpp"
+
+//
+// Larger-than-Life: the neighbourhood of a cell is the (2r+1)x(2r+1) square
+// around it, the cell itself included with M1, and a dead (alive) cell is
+// alive in the next generation if the alive cells of the square are within
+// the birth (survival) interval. Rules are written as in Golly, e.g.
+// Bosco's rule R5,C0,M1,S34..58,B34..45,NM; only 2 states (C0 or C2) and
+// the Moore square (NM) are supported. R1,C0,M0,S2..3,B3..3,NM is Life.
+//
+// Counting a square cell by cell costs (2r+1)^2 adds per cell. The ltl
+// engine builds instead a summed-area table of the board every generation,
+// the sums of all the cells above and to the left of every position, and
+// a square is the difference of 4 of its entries, whatever r.
+//
+
+struct ltl_rule {
+    long r;
+    bool centre; // M1
+    uint32_t s_lo, s_hi, b_lo, b_hi;
+
+    std::string name() const {
+        return "R" + std::to_string(r) + ",C0,M" + (centre ? "1" : "0") +
+               ",S" + std::to_string(s_lo) + ".." + std::to_string(s_hi) +
+               ",B" + std::to_string(b_lo) + ".." + std::to_string(b_hi) +
+               ",NM";
+    }
+
+    // alive is 0 or 1, square the alive cells of the square centred on it
+    template <typename T>
+    T next(T alive, uint32_t square) const {
+        const uint32_t count = square - (centre ? 0 : alive);
+        const uint32_t lo = alive ? s_lo : b_lo, hi = alive ? s_hi : b_hi;
+        return count - lo <= hi - lo;
+    }
+};
+
+static constexpr const char *BOSCO = "R5,C0,M1,S34..58,B34..45,NM";
+
+// "R5,C0,M1,S34..58,B34..45,NM": R, S and B are required, C0, M0 and NM
+// are the defaults
+inline bool parse_ltl(const std::string &s, ltl_rule &rule) {
+    rule = {0, false, 1, 0, 1, 0};
+    bool survive = false, birth = false;
+    for (size_t at = 0; at <= s.size();) {
+        size_t comma = s.find(',', at);
+        if (comma == std::string::npos)
+            comma = s.size();
+        const std::string t = s.substr(at, comma - at);
+        at = comma + 1;
+        if (t.empty())
+            return false;
+        const char key = toupper(t[0]), *v = t.c_str() + 1;
+        unsigned long a, b;
+        int used = 0;
+        if (key == 'N') {
+            if (toupper(v[0]) != 'M' || v[1] != '\0')
+                return false;
+        } else if (key == 'S' || key == 'B') {
+            if (sscanf(v, "%lu..%lu%n", &a, &b, &used) != 2 || v[used] != 0 ||
+                a > b)
+                return false;
+            (key == 'S' ? rule.s_lo : rule.b_lo) = a;
+            (key == 'S' ? rule.s_hi : rule.b_hi) = b;
+            (key == 'S' ? survive : birth) = true;
+        } else {
+            if (sscanf(v, "%lu%n", &a, &used) != 1 || v[used] != 0)
+                return false;
+            if (key == 'R')
+                rule.r = a;
+            else if (key == 'C' && (a == 0 || a == 2))
+                ;
+            else if (key == 'M' && a <= 1)
+                rule.centre = a;
+            else
+                return false;
+        }
+    }
+    return survive && birth && rule.r >= 1 && rule.r <= 1000;
+}
+
+//
+// summed-area table of a Grid<int> board, of which only the rows [first,
+// last) are computed, the others dead, as in the non-torus engines:
+//
+//   R(i, j) = cells of rows first..i and columns 0..j-1
+//
+// for first-1 <= i < last (R(first-1, j) = 0) and -r <= j <= cols+r.
+//
+// The table is built as the drivers compute the board, in chunks of rows
+// in parallel: a chunk [start, end) sums each of its rows left to right,
+// then adds the sums of its previous row, so that its table counts from
+// row start only. The last chunk to finish a generation adds up the totals
+// of the chunks in row order into a carry per chunk, and then
+//
+//   R(i, j) = local[i][j] + carry[chunk of i][j]
+//
+// The carries cost a row of adds per chunk; everything else is parallel.
+// Two tables alternate: the one of the board being read, and the one of
+// the board being computed.
+//
+
+class summed_area {
+   private:
+    long first, last, cols, r;
+    Grid<uint32_t> local[2], carry[2];
+    std::vector<long> origin[2]; // first row of the chunk of each row
+    int current;                 // table of the board being read
+    std::atomic<long> summed;    // rows of the other table
+
+    // the other table, once all its rows are summed
+    void finish() {
+        const int n = current ^ 1;
+        std::fill(carry[n][first] - r, carry[n][first] + cols + r + 1, 0);
+        for (long i = first + 1; i < last; ++i) {
+            if (origin[n][i] != i)
+                continue;
+            const uint32_t *before = carry[n][origin[n][i - 1]],
+                           *total = local[n][i - 1];
+            uint32_t *__restrict c = carry[n][i];
+            for (long j = -r; j <= cols + r; ++j)
+                c[j] = before[j] + total[j];
+        }
+        summed.store(0, std::memory_order_relaxed);
+        current = n;
+    }
+
+   public:
+    summed_area(long rows, long cols, long r, long first, long last)
+        : first(first), last(last), cols(cols), r(r), current(0),
+          summed(0) {
+        for (int n = 0; n < 2; ++n) {
+            local[n] = Grid<uint32_t>(rows, cols + 1, r + 1);
+            carry[n] = Grid<uint32_t>(rows, cols + 1, r + 1);
+            origin[n].assign(rows, -1);
+        }
+    }
+
+    summed_area(const summed_area &) = delete;
+    summed_area &operator=(const summed_area &) = delete;
+
+    // rows [start, end) of the next board, a chunk of it: every row in
+    // [first, last) is summed once per generation, and the table of the
+    // next board replaces the current one after the last
+    void sum_rows(const Grid<int> &board, long start, long end) {
+        if (start == end)
+            return;
+        const int n = current ^ 1;
+        for (long i = start; i < end; ++i) {
+            const int *cells = board[i];
+            uint32_t *__restrict out = local[n][i];
+            uint32_t acc = 0;
+            for (long j = 0; j < cols; ++j) {
+                out[j] = acc;
+                acc += cells[j];
+            }
+            for (long j = cols; j <= cols + r; ++j)
+                out[j] = acc;
+            if (i > start) {
+                const uint32_t *above = local[n][i - 1];
+                for (long j = 0; j <= cols + r; ++j)
+                    out[j] += above[j];
+            }
+            origin[n][i] = start;
+        }
+        if (summed.fetch_add(end - start, std::memory_order_acq_rel) +
+                (end - start) == last - first)
+            finish();
+    }
+
+    // the table of board, nw threads summing a band of rows each
+    void build(const Grid<int> &board, int nw) {
+        parallel_for(nw, [&](int t) {
+            sum_rows(board, first + (last - first) * t / nw,
+                     first + (last - first) * (t + 1) / nw);
+        });
+    }
+
+    // w[j] = R(i + r, j) - R(i - r - 1, j), clipped to [first-1, last),
+    // for -r <= j <= cols + r: the (2r+1)^2 square around cell j of row i
+    // then holds w[j + r + 1] - w[j - r] alive cells
+    void window(long i, uint32_t *w) const {
+        const int n = current;
+        const long top = std::max(first, i - r) - 1,
+                   bottom = std::min(last - 1, i + r);
+        // row first - 1 has no chunk, its carry is the zero halo row
+        const uint32_t *lb = local[n][bottom],
+                       *cb = carry[n][origin[n][bottom]],
+                       *lt = local[n][top], *ct = carry[n][origin[n][top]];
+        for (long j = -r; j <= cols + r; ++j)
+            w[j] = lb[j] + cb[j] - lt[j] - ct[j];
+    }
+
+    // rows [start, end) of future from board, then their sums
+    void advance(const ltl_rule &rule, const Grid<int> &board,
+                 Grid<int> &future, long start, long end,
+                 std::vector<uint32_t> &scratch) {
+        scratch.resize(cols + 2 * r + 1);
+        uint32_t *w = scratch.data() + r;
+        for (long i = start; i < end; ++i) {
+            window(i, w);
+            const int *mid = board[i];
+            int *__restrict out = future[i];
+            for (long j = 1; j < cols - 1; ++j)
+                out[j] = rule.next(mid[j], w[j + r + 1] - w[j - r]);
+        }
+        sum_rows(future, start, end);
+    }
+};
+
+// a generation of the engine against the squares counted cell by cell, on
+// random boards smaller and larger than the squares, the tables built and
+// used in chunks of a few sizes
+inline bool ltl_self_check(const ltl_rule &rule) {
+    const long sizes[][2] = {{5, 6}, {23, 41}, {64, 37}};
+    int seed = 1;
+    for (auto &size : sizes) {
+        const long rows = size[0], cols = size[1];
+        Grid<int> board(rows, cols, 1), future(rows, cols, 1);
+        const cell_random rng(seed++, 0.4);
+        for (long i = 1; i < rows - 1; ++i)
+            for (long j = 1; j < cols - 1; ++j)
+                board[i][j] = rng.alive(i * cols + j);
+
+        summed_area sat(rows, cols, rule.r, 1, rows - 1);
+        std::vector<uint32_t> scratch;
+        sat.build(board, 3);
+        for (long i = 1; i < rows - 1; i += 4)
+            sat.advance(rule, board, future, i, std::min(i + 4, rows - 1),
+                        scratch);
+
+        for (long i = 1; i < rows - 1; ++i)
+            for (long j = 1; j < cols - 1; ++j) {
+                uint32_t square = 0;
+                for (long y = std::max(0L, i - rule.r);
+                     y <= std::min(rows - 1, i + rule.r); ++y)
+                    for (long x = std::max(0L, j - rule.r);
+                         x <= std::min(cols - 1, j + rule.r); ++x)
+                        square += board[y][x];
+                if (future[i][j] != rule.next(board[i][j], square))
+                    return false;
+            }
+    }
+    return true;
+}
+
+#endif
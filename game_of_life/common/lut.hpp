@@ -0,0 +1,104 @@
+#ifndef LUT_HPP
+#define LUT_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "rules.hpp"
+
+//
+// lookup table kernel: a 2x2 block of the next generation only depends on
+// the 4x4 cells around it, i.e. on 16 bits, so the blocks are read from a
+// table of 64K entries computed at startup for the rule in use.
+//
+// It runs on the bit-packed rows of bitboard: the 4 cells of an input row
+// are a nibble taken with a shift, the four nibbles form the index
+//
+//     n0 | n1 << 4 | n2 << 8 | n3 << 12
+//
+// with n0 the row above the block, bit c of a nibble being column j-1+c for
+// a block at columns j, j+1. An entry holds the block as bits
+// (i, j), (i, j+1), (i+1, j), (i+1, j+1).
+//
+class lut_kernel {
+   private:
+    std::vector<uint8_t> table;
+    std::vector<uint64_t> zero; // row past the bottom border
+
+   public:
+    lut_kernel(const rule_spec &rule, size_t words)
+        : table(1 << 16), zero(words, 0) {
+        for (unsigned index = 0; index < table.size(); ++index) {
+            auto cell = [index](int r, int c) {
+                return index >> (4 * r + c) & 1;
+            };
+            uint8_t block = 0;
+            for (int r = 1; r <= 2; ++r)
+                for (int c = 1; c <= 2; ++c) {
+                    unsigned alive_neighbours = 0;
+                    for (int dr = -1; dr <= 1; ++dr)
+                        for (int dc = -1; dc <= 1; ++dc)
+                            alive_neighbours += cell(r + dr, c + dc);
+                    alive_neighbours -= cell(r, c);
+                    const unsigned mask =
+                        cell(r, c) ? rule.survive : rule.birth;
+                    block |= (mask >> alive_neighbours & 1)
+                             << (2 * (r - 1) + (c - 1));
+                }
+            table[index] = block;
+        }
+    }
+
+    // computes rows [from, to) of future, two rows per pass; as for
+    // bitboard::step the border rows and columns are never written
+    void step(const bitboard &board, bitboard &future, size_t from,
+              size_t to) const {
+        const size_t words = board.words(), last = words - 1;
+        for (size_t i = from; i < to; i += 2) {
+            const bool pair = i + 1 < to;
+            const uint64_t *in[4] = {
+                board.row(i - 1), board.row(i), board.row(i + 1),
+                i + 2 < board.rows() ? board.row(i + 2) : zero.data()};
+            uint64_t *out0 = future.row(i);
+            uint64_t *out1 = pair ? future.row(i + 1) : nullptr;
+
+            for (size_t k = 0; k < words; ++k) {
+                // bit t of lo[r] is column 64k + t - 1 of input row r
+                uint64_t lo[4], top[4];
+                for (int r = 0; r < 4; ++r) {
+                    const uint64_t w = in[r][k];
+                    const uint64_t prev = k > 0 ? in[r][k - 1] : 0;
+                    const uint64_t next = k < last ? in[r][k + 1] : 0;
+                    lo[r] = (w << 1) | (prev >> 63);
+                    // the nibble of the last block crosses into next
+                    top[r] = (lo[r] >> 62) | ((w >> 63) << 2) |
+                             ((next & 1) << 3);
+                }
+
+                uint64_t r0 = 0, r1 = 0;
+                for (int m = 0; m < 32; ++m) {
+                    unsigned index;
+                    if (m < 31)
+                        index = (lo[0] >> (2 * m) & 0xf) |
+                                (lo[1] >> (2 * m) & 0xf) << 4 |
+                                (lo[2] >> (2 * m) & 0xf) << 8 |
+                                (lo[3] >> (2 * m) & 0xf) << 12;
+                    else
+                        index = top[0] | top[1] << 4 | top[2] << 8 |
+                                top[3] << 12;
+                    const uint64_t block = table[index];
+                    r0 |= (block & 3) << (2 * m);
+                    r1 |= (block >> 2) << (2 * m);
+                }
+
+                const uint64_t mask = board.inner_mask(k);
+                out0[k] = r0 & mask;
+                if (pair)
+                    out1[k] = r1 & mask;
+            }
+        }
+    }
+};
+
+#endif
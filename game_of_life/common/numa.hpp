@@ -0,0 +1,202 @@
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grid.hpp"
+
+//
+// NUMA placement (Linux only): workers are pinned to cores read from
+// /sys/devices/system/node, spread over the nodes in blocks so that
+// neighbouring row blocks share a node, and every worker first-touches the
+// rows it owns so that their pages are allocated on its node.
+//
+
+// "0-3,8,10-11" to {0, 1, 2, 3, 8, 10, 11}
+inline std::vector<int> parse_cpulist(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n")
+            continue;
+        const auto dash = range.find('-');
+        const int lo = atoi(range.c_str());
+        const int hi = dash == std::string::npos
+                           ? lo
+                           : atoi(range.c_str() + dash + 1);
+        for (int c = lo; c <= hi; ++c)
+            cpus.push_back(c);
+    }
+    return cpus;
+}
+
+class numa_layout {
+   private:
+    int nw;
+    std::vector<std::vector<int>> node_cpus; // cpus of each node
+    std::vector<int> worker_cpu, worker_node;
+
+    static std::string read_line(const std::string &path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    // node of the page holding p, -1 if unknown
+    static int page_node(const void *p) {
+        void *page = const_cast<void *>(p);
+        int status = -1;
+        if (syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) != 0)
+            return -1;
+        return status;
+    }
+
+    // GB/s reading rows [from, to) of board, a few passes
+    template <typename T>
+    static double read_bandwidth(const Grid<T> &board, long from, long to) {
+        const int passes = 5;
+        volatile T sink = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int p = 0; p < passes; ++p) {
+            T sum = 0;
+            for (long i = from; i < to; ++i) {
+                const T *row = board[i];
+                for (long j = 0; j < board.cols(); ++j)
+                    sum += row[j];
+            }
+            sink = sink + sum;
+        }
+        const double s = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - t0)
+                             .count();
+        const double bytes =
+            double(passes) * (to - from) * board.cols() * sizeof(T);
+        return s > 0 ? bytes / s / 1e9 : 0;
+    }
+
+   public:
+    numa_layout(int nw) : nw(nw) {
+        for (int n = 0;; ++n) {
+            const std::string dir =
+                "/sys/devices/system/node/node" + std::to_string(n);
+            std::ifstream probe(dir + "/cpulist");
+            if (!probe)
+                break;
+            std::vector<int> cpus = parse_cpulist(read_line(dir + "/cpulist"));
+            if (!cpus.empty())
+                node_cpus.push_back(cpus);
+        }
+        if (node_cpus.empty()) // no NUMA information, a single node
+            node_cpus.push_back(
+                parse_cpulist(read_line("/sys/devices/system/cpu/online")));
+        if (node_cpus[0].empty())
+            node_cpus[0].push_back(0);
+
+        // worker w on node w * nodes / nw, cores of a node used in order
+        const int nodes = node_cpus.size();
+        for (int w = 0; w < nw; ++w) {
+            const int node = long(w) * nodes / nw;
+            const int first = (long(node) * nw + nodes - 1) / nodes;
+            const std::vector<int> &cpus = node_cpus[node];
+            worker_node.push_back(node);
+            worker_cpu.push_back(cpus[(w - first) % cpus.size()]);
+        }
+    }
+
+    int nodes() const { return node_cpus.size(); }
+    int cpu(int w) const { return worker_cpu[w]; }
+    int node(int w) const { return worker_node[w]; }
+
+    // pins the calling thread to the core of worker w
+    bool pin(int w) const {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker_cpu[w], &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    // rows [from, to) owned by worker w when the rows [first, last) are cut
+    // in nw blocks as by the static source; the rows before first and after
+    // last, halo included, go to the first and the last worker
+    void owned_rows(int w, long rows, long halo, long first, long last,
+                    long &from, long &to) const {
+        const long chunk = (last - first) / nw;
+        from = w == 0 ? -halo : first + w * chunk;
+        to = w == nw - 1 ? rows + halo : first + (w + 1) * chunk;
+    }
+
+    // f(w, from, to) on nw threads pinned as the workers, on their rows
+    template <typename F>
+    void run(long rows, long halo, long first, long last, F f) const {
+        std::vector<std::thread> tids;
+        for (int w = 0; w < nw; ++w)
+            tids.emplace_back([&, w] {
+                long from, to;
+                pin(w);
+                owned_rows(w, rows, halo, first, last, from, to);
+                f(w, from, to);
+            });
+        for (auto &t : tids)
+            t.join();
+    }
+
+    // for each worker, in turn: where its rows landed and the bandwidth
+    // reading them and the rows of a worker on another node
+    template <typename T>
+    void report(const Grid<T> &board, long first, long last) const {
+        const long page = sysconf(_SC_PAGESIZE);
+        for (int w = 0; w < nw; ++w) {
+            int remote = -1;
+            for (int v = 0; v < nw && remote < 0; ++v)
+                if (worker_node[v] != worker_node[w])
+                    remote = v;
+            std::thread t([&, w, remote] {
+                long from, to;
+                pin(w);
+                owned_rows(w, board.rows(), 0, first, last, from, to);
+                long pages = 0, local = 0;
+                for (long i = from; i < to; ++i) {
+                    const char *b = reinterpret_cast<const char *>(board[i]);
+                    const char *e = b + board.cols() * sizeof(T);
+                    for (const char *p = b - (uintptr_t(b) % page); p < e;
+                         p += page, ++pages)
+                        local += page_node(p) == worker_node[w];
+                }
+                std::cout << "Worker " << w << " on cpu " << worker_cpu[w]
+                          << ", node " << worker_node[w] << ": "
+                          << 100.0 * local / std::max(pages, 1L)
+                          << "% of its row pages local, "
+                          << read_bandwidth(board, from, to)
+                          << " GB/s local";
+                if (remote >= 0) {
+                    owned_rows(remote, board.rows(), 0, first, last, from,
+                               to);
+                    std::cout << ", " << read_bandwidth(board, from, to)
+                              << " GB/s remote (node " << worker_node[remote]
+                              << ")";
+                } else {
+                    std::cout << ", no remote node";
+                }
+                std::cout << std::endl;
+            });
+            t.join();
+        }
+    }
+};
+
+#endif
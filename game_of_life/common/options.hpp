@@ -0,0 +1,43 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <cstdlib>
+#include <map>
+#include <string>
+
+// optional "--name=value" (or bare "--name") flags given after the
+// positional arguments of the drivers
+class options {
+   private:
+    std::map<std::string, std::string> flags;
+
+   public:
+    options(int argc, char const *const *argv, int first) {
+        for (int i = first; i < argc; ++i) {
+            std::string arg(argv[i]);
+            if (arg.compare(0, 2, "--") != 0)
+                continue;
+            auto eq = arg.find('=');
+            if (eq == std::string::npos)
+                flags[arg.substr(2)] = "1";
+            else
+                flags[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+        }
+    }
+
+    bool has(const std::string &name) const {
+        return flags.count(name) != 0;
+    }
+
+    std::string get(const std::string &name, const std::string &def) const {
+        auto it = flags.find(name);
+        return it == flags.end() ? def : it->second;
+    }
+
+    long get(const std::string &name, long def) const {
+        auto it = flags.find(name);
+        return it == flags.end() ? def : atol(it->second.c_str());
+    }
+};
+
+#endif
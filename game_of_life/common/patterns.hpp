@@ -0,0 +1,365 @@
+#ifndef PATTERNS_HPP
+#define PATTERNS_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grid.hpp"
+
+//
+// pattern files: RLE (x = .., y = .. header, runs of b/o/$ ended by !) and
+// Life 1.06 (one "x y" live cell per line).
+//
+// The file is memory-mapped and parsed by nw threads working on chunks of
+// it, so that the cells go straight from the page cache to the board.
+// Cells falling outside the board, or on its dead border, are dropped.
+//
+
+// read-only memory mapping of a whole file
+class mapped_file {
+   private:
+    int fd;
+    size_t length;
+    const char *ptr;
+
+   public:
+    mapped_file(const std::string &path) : fd(-1), length(0), ptr(nullptr) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat s;
+        if (fstat(fd, &s) != 0 || s.st_size == 0)
+            return;
+        length = s.st_size;
+        void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            length = 0;
+            return;
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+        ptr = static_cast<const char *>(p);
+    }
+
+    ~mapped_file() {
+        if (ptr != nullptr)
+            munmap(const_cast<char *>(ptr), length);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    bool valid() const { return ptr != nullptr; }
+    const char *data() const { return ptr; }
+    size_t size() const { return length; }
+};
+
+struct pattern_info {
+    long rows, cols;  // RLE bounding box, 0 for Life 1.06
+    std::string rule; // RLE rule, B3/S23 if missing
+};
+
+// runs [0, n) of f(t) on n threads
+template <typename F>
+inline void parallel_for(int n, F f) {
+    std::vector<std::thread> tids;
+    for (int t = 1; t < n; ++t)
+        tids.emplace_back(f, t);
+    f(0);
+    for (auto &t : tids)
+        t.join();
+}
+
+namespace patterns {
+
+// parses an integer within [q, end), moving q past it
+inline bool parse_long(const char *&q, const char *end, long &v) {
+    while (q < end && (*q == ' ' || *q == '\t' || *q == '\r'))
+        ++q;
+    bool negative = q < end && *q == '-';
+    if (q < end && (*q == '-' || *q == '+'))
+        ++q;
+    if (q == end || !isdigit((unsigned char)*q))
+        return false;
+    for (v = 0; q < end && isdigit((unsigned char)*q); ++q)
+        v = v * 10 + (*q - '0');
+    if (negative)
+        v = -v;
+    return true;
+}
+
+// first position after p where a chunk of the RLE data can start, i.e.
+// right after a tag, so that no run count is split
+inline const char *rle_boundary(const char *p, const char *begin,
+                                const char *end) {
+    while (p > begin && p < end &&
+           (isdigit((unsigned char)p[-1]) || isspace((unsigned char)p[-1])))
+        ++p;
+    return p;
+}
+
+// walks the runs in [p, end) from (row, col); with SET the alive cells are
+// stored, otherwise only the final position is computed. Returns true if
+// the end of pattern (!) was met
+template <bool SET, typename T>
+inline bool rle_walk(const char *p, const char *end, long &row, long &col,
+                     bool &reset, Grid<T> *board, long r0, long c0, long b) {
+    long count = 0;
+    for (; p < end; ++p) {
+        const char c = *p;
+        if (isdigit((unsigned char)c)) {
+            count = count * 10 + (c - '0');
+            continue;
+        }
+        if (isspace((unsigned char)c))
+            continue;
+        const long n = count == 0 ? 1 : count;
+        count = 0;
+        if (c == '!')
+            return true;
+        if (c == '$') {
+            row += n;
+            col = 0;
+            reset = true;
+        } else {
+            if (SET && c != 'b' && c != '.') {
+                const long i = r0 + row;
+                const long lo = std::max(c0 + col, b);
+                const long hi = std::min(c0 + col + n, board->cols() - b);
+                if (i >= b && i < board->rows() - b)
+                    for (long j = lo; j < hi; ++j)
+                        (*board)[i][j] = 1;
+            }
+            col += n;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+inline bool load_rle(const char *p, const char *end, Grid<T> &board,
+                     pattern_info &info, long b, int nw) {
+    // comments, then the header line
+    info.rule = "B3/S23";
+    info.rows = info.cols = 0;
+    while (p < end && (*p == '#' || isspace((unsigned char)*p))) {
+        if (*p == '#')
+            p = std::find(p, end, '\n');
+        if (p < end)
+            ++p;
+    }
+    const char *eol = std::find(p, end, '\n');
+    std::string header(p, eol);
+    for (auto &c : header)
+        if (c == ',' || c == '=')
+            c = ' ';
+    char key[64], value[64];
+    const char *h = header.c_str();
+    int used;
+    while (sscanf(h, "%63s %63s%n", key, value, &used) == 2) {
+        if (strcmp(key, "x") == 0)
+            info.cols = atol(value);
+        else if (strcmp(key, "y") == 0)
+            info.rows = atol(value);
+        else if (strcmp(key, "rule") == 0)
+            info.rule = value;
+        h += used;
+    }
+    if (info.rows <= 0 || info.cols <= 0) {
+        std::cout << "RLE header without size: " << header << std::endl;
+        return false;
+    }
+    p = eol;
+
+    // centred on the board
+    const long r0 = (board.rows() - info.rows) / 2;
+    const long c0 = (board.cols() - info.cols) / 2;
+
+    // chunks of the run data, split right after a tag
+    std::vector<const char *> split(nw + 1);
+    split[0] = p;
+    split[nw] = end;
+    for (int t = 1; t < nw; ++t)
+        split[t] = rle_boundary(
+            std::max(split[t - 1], p + (end - p) * t / nw), p, end);
+
+    // first pass: where each chunk moves the cursor
+    std::vector<long> dy(nw, 0), x(nw, 0);
+    std::vector<char> reset(nw, 0), stop(nw, 0);
+    parallel_for(nw, [&](int t) {
+        long row = 0, col = 0;
+        bool r = false;
+        stop[t] = rle_walk<false, T>(split[t], split[t + 1], row, col, r,
+                                     nullptr, 0, 0, b);
+        dy[t] = row;
+        x[t] = col;
+        reset[t] = r;
+    });
+
+    // prefix: starting position of each chunk
+    std::vector<long> row(nw, 0), col(nw, 0);
+    int chunks = nw;
+    for (int t = 0; t + 1 < nw; ++t) {
+        if (stop[t]) {
+            chunks = t + 1;
+            break;
+        }
+        row[t + 1] = row[t] + dy[t];
+        col[t + 1] = reset[t] ? x[t] : col[t] + x[t];
+    }
+
+    // second pass: cells to the board
+    parallel_for(nw, [&](int t) {
+        if (t >= chunks)
+            return;
+        bool r = false;
+        rle_walk<true>(split[t], split[t + 1], row[t], col[t], r, &board,
+                       r0, c0, b);
+    });
+    return true;
+}
+
+template <typename T>
+inline bool load_life106(const char *p, const char *end, Grid<T> &board,
+                         long b, int nw) {
+    // (0, 0) is the centre of the board
+    const long r0 = board.rows() / 2, c0 = board.cols() / 2;
+
+    // chunks of whole lines
+    std::vector<const char *> split(nw + 1);
+    split[0] = p;
+    split[nw] = end;
+    for (int t = 1; t < nw; ++t) {
+        const char *q = std::max(split[t - 1], p + (end - p) * t / nw);
+        split[t] = std::find(q, end, '\n');
+    }
+
+    parallel_for(nw, [&](int t) {
+        const char *q = split[t], *e = split[t + 1];
+        while (q < e) {
+            const char *eol = std::find(q, e, '\n');
+            long x, y;
+            if (*q != '#' && parse_long(q, eol, x) && parse_long(q, eol, y)) {
+                const long i = r0 + y, j = c0 + x;
+                if (i >= b && i < board.rows() - b &&
+                    j >= b && j < board.cols() - b)
+                    board[i][j] = 1;
+            }
+            q = eol + 1;
+        }
+    });
+    return true;
+}
+
+}  // namespace patterns
+
+// loads an RLE or Life 1.06 file into the board, centred; b is the dead
+// border width (0 on a torus)
+template <typename T>
+inline bool load_pattern(const std::string &path, Grid<T> &board,
+                         pattern_info &info, long b, int nw) {
+    mapped_file file(path);
+    if (!file.valid()) {
+        std::cout << "Failed opening pattern " << path << std::endl;
+        return false;
+    }
+    const char *p = file.data(), *end = p + file.size();
+    nw = std::max(1, std::min<int>(nw, file.size() / 4096 + 1));
+    info.rows = info.cols = 0;
+    info.rule = "B3/S23";
+    if (file.size() >= 10 && strncmp(p, "#Life 1.06", 10) == 0)
+        return patterns::load_life106(p, end, board, b, nw);
+    return patterns::load_rle(p, end, board, info, b, nw);
+}
+
+// writes the live cells of the board, as RLE (bounding box, lines of at
+// most 70 characters) or, for .lif/.life files, as Life 1.06 relative to
+// the centre of the board; the RLE header names rule, the one the board
+// was run with
+template <typename T, typename RULE>
+inline bool save_pattern(const std::string &path, const Grid<T> &board,
+                         const RULE &rule) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (f == nullptr) {
+        std::cout << "Failed opening " << path << std::endl;
+        return false;
+    }
+    const bool life106 =
+        path.size() >= 4 && (path.compare(path.size() - 4, 4, ".lif") == 0 ||
+                             (path.size() >= 5 &&
+                              path.compare(path.size() - 5, 5, ".life") == 0));
+    std::string out;
+    if (life106) {
+        out = "#Life 1.06\n";
+        const long r0 = board.rows() / 2, c0 = board.cols() / 2;
+        for (long i = 0; i < board.rows(); ++i)
+            for (long j = 0; j < board.cols(); ++j)
+                if (board[i][j])
+                    out += std::to_string(j - c0) + " " +
+                           std::to_string(i - r0) + "\n";
+    } else {
+        long top = board.rows(), bottom = -1, left = board.cols(), right = -1;
+        for (long i = 0; i < board.rows(); ++i)
+            for (long j = 0; j < board.cols(); ++j)
+                if (board[i][j]) {
+                    top = std::min(top, i);
+                    bottom = std::max(bottom, i);
+                    left = std::min(left, j);
+                    right = std::max(right, j);
+                }
+        if (bottom < 0)
+            top = bottom = left = right = 0;
+        out = "x = " + std::to_string(right - left + 1) +
+              ", y = " + std::to_string(bottom - top + 1) +
+              ", rule = " + rule.name() + "\n";
+        size_t line = 0;  // characters in the current output line
+        auto emit = [&](long n, char tag) {
+            std::string run = (n > 1 ? std::to_string(n) : "") + tag;
+            if (line + run.size() > 70) {
+                out += '\n';
+                line = 0;
+            }
+            out += run;
+            line += run.size();
+        };
+        long pending_rows = 0; // '$' owed before the next live row
+        for (long i = top; i <= bottom; ++i) {
+            if (i > top)
+                ++pending_rows;
+            long last = right; // trailing dead cells are not written
+            while (last >= left && !board[i][last])
+                --last;
+            if (last < left)
+                continue;
+            if (pending_rows > 0)
+                emit(pending_rows, '$');
+            pending_rows = 0;
+            for (long j = left; j <= last;) {
+                long k = j;
+                while (k <= last && (board[i][k] != 0) == (board[i][j] != 0))
+                    ++k;
+                emit(k - j, board[i][j] ? 'o' : 'b');
+                j = k;
+            }
+        }
+        emit(1, '!');
+        out += '\n';
+    }
+    bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,468 @@
+#ifndef RECORD_HPP
+#define RECORD_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "grid.hpp"
+#include "patterns.hpp"
+
+// build with -DGOL_MINIZ to allow --compress
+#ifdef GOL_MINIZ
+#include "../../compressor/miniz/miniz.c"
+#endif
+
+//
+// boards packed 64 cells per word, the bitboard layout, as the checkpoints
+// and the recordings store them
+//
+
+inline void pack_board(const bitboard &board, uint64_t *out) {
+    for (size_t i = 0; i < board.rows(); ++i)
+        std::memcpy(out + i * board.words(), board.row(i),
+                    board.words() * sizeof(uint64_t));
+}
+
+template <typename T>
+inline void pack_board(const Grid<T> &board, uint64_t *out) {
+    const long words = (board.cols() + 63) / 64;
+    for (long i = 0; i < board.rows(); ++i) {
+        const T *row = board[i];
+        uint64_t *w = out + i * words;
+        for (long k = 0; k < words; ++k) {
+            uint64_t bits = 0;
+            const long last = std::min(board.cols() - 64 * k, 64L);
+            for (long j = 0; j < last; ++j)
+                bits |= uint64_t(row[64 * k + j] != 0) << j;
+            w[k] = bits;
+        }
+    }
+}
+
+inline void unpack_board(const uint64_t *in, bitboard &board) {
+    for (size_t i = 0; i < board.rows(); ++i)
+        std::memcpy(board.row(i), in + i * board.words(),
+                    board.words() * sizeof(uint64_t));
+}
+
+template <typename T>
+inline void unpack_board(const uint64_t *in, Grid<T> &board) {
+    const long words = (board.cols() + 63) / 64;
+    for (long i = 0; i < board.rows(); ++i)
+        for (long j = 0; j < board.cols(); ++j)
+            board[i][j] = (in[i * words + j / 64] >> (j % 64)) & 1;
+}
+
+//
+// recording of a whole run, --record=file: every generation is stored as
+// the XOR of its packed board with the previous one, run-length encoded,
+// except for a keyframe, the board itself, every --keyframe-every
+// generations. A keyframe and the deltas up to the next one make a block,
+// compressed as a whole with --compress, and an index of the blocks at the
+// end of the file lets a replay reach any generation decoding at most one
+// block.
+//
+// The compute threads only pack the board into a free buffer; a thread of
+// the recorder encodes, compresses and writes. When all the buffers are
+// waiting for it, the simulation waits too: a recording has no gaps.
+//
+// File: record_header, then per block a record_block and its payload, then
+// the index, an array of record_index_entry, and the record_trailer. A
+// payload is, per generation, the words [generation, keyframe, n] and n
+// words of tokens: a token word (zero words << 32 | literal words) is
+// followed by the literal words.
+//
+
+struct record_header {
+    char magic[8]; // GOLREC01
+    uint64_t rows, cols; // whole board, border included
+    uint64_t keyframe_every;
+    int64_t seed;
+};
+
+struct record_block {
+    uint64_t first_generation, generations;
+    uint64_t raw_bytes, stored_bytes;
+    uint64_t compressed;
+};
+
+struct record_index_entry {
+    uint64_t first_generation;
+    uint64_t offset; // of the record_block
+};
+
+struct record_trailer {
+    uint64_t index_offset, blocks;
+    char magic[8]; // GOLRIDX1
+};
+
+// run-length encoding of n words, appended to out
+inline void rle_encode(const uint64_t *w, size_t n,
+                       std::vector<uint64_t> &out) {
+    const size_t MAX_RUN = 0xffffffff;
+    for (size_t k = 0; k < n;) {
+        size_t z = k;
+        while (z < n && w[z] == 0 && z - k < MAX_RUN)
+            ++z;
+        size_t l = z;
+        while (l < n && w[l] != 0 && l - z < MAX_RUN)
+            ++l;
+        out.push_back(uint64_t(z - k) << 32 | (l - z));
+        out.insert(out.end(), w + z, w + l);
+        k = l;
+    }
+}
+
+// XORs the n words encoded in [in, end) into w, false if they do not fit
+inline bool rle_apply(const uint64_t *in, const uint64_t *end, uint64_t *w,
+                      size_t n) {
+    size_t k = 0;
+    while (in < end) {
+        const uint64_t zeros = *in >> 32, literals = *in & 0xffffffff;
+        ++in;
+        k += zeros;
+        if (k + literals > n || uint64_t(end - in) < literals)
+            return false;
+        for (uint64_t l = 0; l < literals; ++l)
+            w[k++] ^= *in++;
+    }
+    return true;
+}
+
+class recorder {
+   private:
+    static constexpr char MAGIC[9] = "GOLREC01";
+    static constexpr char INDEX_MAGIC[9] = "GOLRIDX1";
+    static constexpr int BUFFERS = 4;
+
+    std::string path;
+    FILE *file;
+    uint64_t keyframe_every;
+    int seed;
+    bool compress;
+
+    // handed over by tick(), encoded by the thread
+    uint64_t rows, cols, words; // set by the first tick(), then read-only
+    std::vector<std::vector<uint64_t>> buffers;
+    std::vector<unsigned long> buffer_generation;
+    std::vector<int> free_buffers;
+    std::deque<int> ready; // in generation order
+    std::mutex lock;
+    std::condition_variable cv_ready, cv_free;
+    bool stop;
+    std::thread encoder;
+
+    // owned by the thread
+    std::vector<uint64_t> previous, delta, batch;
+    uint64_t batch_first, batch_generations, recorded, offset;
+    std::vector<record_index_entry> index;
+    bool failed;
+
+    bool put(const void *p, size_t bytes) {
+        if (!failed && fwrite(p, 1, bytes, file) != bytes) {
+            std::cout << "Failed writing " << path << std::endl;
+            failed = true;
+        }
+        offset += bytes;
+        return !failed;
+    }
+
+    // the block of the current keyframe
+    void flush() {
+        if (batch_generations == 0)
+            return;
+        record_block b;
+        std::memset(&b, 0, sizeof(b));
+        b.first_generation = batch_first;
+        b.generations = batch_generations;
+        b.raw_bytes = batch.size() * sizeof(uint64_t);
+        b.stored_bytes = b.raw_bytes;
+        const unsigned char *payload =
+            reinterpret_cast<const unsigned char *>(batch.data());
+#ifdef GOL_MINIZ
+        std::vector<unsigned char> packed;
+        if (compress) {
+            mz_ulong len = mz_compressBound(b.raw_bytes);
+            packed.resize(len);
+            if (mz_compress2(packed.data(), &len, payload, b.raw_bytes,
+                             MZ_BEST_SPEED) == MZ_OK) {
+                payload = packed.data();
+                b.stored_bytes = len;
+                b.compressed = 1;
+            }
+        }
+#endif
+        index.push_back({batch_first, offset});
+        put(&b, sizeof(b));
+        put(payload, b.stored_bytes);
+        batch.clear();
+        batch_generations = 0;
+    }
+
+    void encode(const std::vector<uint64_t> &board, unsigned long g) {
+        if (recorded == 0) {
+            record_header h;
+            std::memset(&h, 0, sizeof(h));
+            std::memcpy(h.magic, MAGIC, sizeof(h.magic));
+            h.rows = rows;
+            h.cols = cols;
+            h.keyframe_every = keyframe_every;
+            h.seed = seed;
+            put(&h, sizeof(h));
+            previous.assign(words, 0);
+            delta.resize(words);
+        }
+        const bool key = recorded % keyframe_every == 0;
+        if (key)
+            flush();
+        if (batch_generations == 0)
+            batch_first = g;
+
+        batch.push_back(g);
+        batch.push_back(key);
+        const size_t at = batch.size();
+        batch.push_back(0);
+        if (key) {
+            rle_encode(board.data(), words, batch);
+        } else {
+            for (size_t k = 0; k < words; ++k)
+                delta[k] = board[k] ^ previous[k];
+            rle_encode(delta.data(), words, batch);
+        }
+        batch[at] = batch.size() - at - 1;
+        std::memcpy(previous.data(), board.data(), words * sizeof(uint64_t));
+        ++batch_generations;
+        ++recorded;
+    }
+
+    void encode_loop() {
+        std::unique_lock<std::mutex> l(lock);
+        while (true) {
+            cv_ready.wait(l, [this] { return stop || !ready.empty(); });
+            if (ready.empty())
+                break;
+            const int b = ready.front();
+            ready.pop_front();
+            l.unlock();
+            encode(buffers[b], buffer_generation[b]);
+            l.lock();
+            free_buffers.push_back(b);
+            cv_free.notify_one();
+        }
+        l.unlock();
+
+        flush();
+        record_trailer t;
+        std::memset(&t, 0, sizeof(t));
+        t.index_offset = offset;
+        t.blocks = index.size();
+        std::memcpy(t.magic, INDEX_MAGIC, sizeof(t.magic));
+        put(index.data(), index.size() * sizeof(record_index_entry));
+        put(&t, sizeof(t));
+    }
+
+   public:
+    recorder(const std::string &path, unsigned long keyframe_every, int seed,
+             bool compress)
+        : path(path), file(fopen(path.c_str(), "wb")),
+          keyframe_every(keyframe_every > 0 ? keyframe_every : 1),
+          seed(seed), compress(compress), rows(0), cols(0), words(0),
+          buffers(BUFFERS), buffer_generation(BUFFERS), stop(false),
+          batch_first(0), batch_generations(0), recorded(0), offset(0),
+          failed(false) {
+        if (file == nullptr) {
+            std::cout << "Failed opening " << path << std::endl;
+            return;
+        }
+        for (int b = 0; b < BUFFERS; ++b)
+            free_buffers.push_back(b);
+        encoder = std::thread(&recorder::encode_loop, this);
+    }
+
+    // waits for the generations handed over, then writes the index
+    ~recorder() {
+        if (file == nullptr)
+            return;
+        {
+            std::unique_lock<std::mutex> l(lock);
+            stop = true;
+        }
+        cv_ready.notify_one();
+        encoder.join();
+        if (fclose(file) != 0 && !failed)
+            std::cout << "Failed writing " << path << std::endl;
+        else if (!failed)
+            std::cout << "Recorded " << recorded << " generations in "
+                      << index.size() << " blocks, " << offset << " bytes"
+                      << std::endl;
+    }
+
+    recorder(const recorder &) = delete;
+    recorder &operator=(const recorder &) = delete;
+
+    // board is generation g
+    template <typename BOARD>
+    void tick(const BOARD &board, unsigned long g) {
+        if (file == nullptr)
+            return;
+        int b;
+        {
+            std::unique_lock<std::mutex> l(lock);
+            cv_free.wait(l, [this] { return !free_buffers.empty(); });
+            b = free_buffers.back();
+            free_buffers.pop_back();
+            // the encoder reads them unlocked once handed a buffer
+            if (words == 0) {
+                rows = board.rows();
+                cols = board.cols();
+                words = rows * ((cols + 63) / 64);
+            }
+        }
+        buffers[b].resize(words);
+        pack_board(board, buffers[b].data());
+        buffer_generation[b] = g;
+        {
+            std::unique_lock<std::mutex> l(lock);
+            ready.push_back(b);
+        }
+        cv_ready.notify_one();
+    }
+};
+
+// a recording, read back
+class replay {
+   private:
+    mapped_file file;
+    record_header header;
+    record_trailer trailer;
+    std::vector<record_index_entry> index; // copied, blocks are unaligned
+    bool valid;
+
+   public:
+    replay(const std::string &path)
+        : file(path), valid(false) {
+        if (!file.valid() ||
+            file.size() < sizeof(header) + sizeof(trailer)) {
+            std::cout << "Failed opening recording " << path << std::endl;
+            return;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        std::memcpy(&trailer, file.data() + file.size() - sizeof(trailer),
+                    sizeof(trailer));
+        if (std::memcmp(header.magic, "GOLREC01", 8) != 0 ||
+            std::memcmp(trailer.magic, "GOLRIDX1", 8) != 0 ||
+            header.rows == 0 || header.rows > UINT32_MAX ||
+            header.cols == 0 || header.cols > UINT32_MAX ||
+            header.keyframe_every == 0 ||
+            trailer.blocks > file.size() / sizeof(record_index_entry) ||
+            trailer.index_offset > file.size() ||
+            trailer.index_offset +
+                    trailer.blocks * sizeof(record_index_entry) +
+                    sizeof(trailer) != file.size()) {
+            std::cout << "Not a complete recording: " << path << std::endl;
+            return;
+        }
+        index.resize(trailer.blocks);
+        std::memcpy(index.data(), file.data() + trailer.index_offset,
+                    trailer.blocks * sizeof(record_index_entry));
+        valid = trailer.blocks > 0;
+    }
+
+    bool ok() const { return valid; }
+    uint64_t rows() const { return header.rows; }
+    uint64_t cols() const { return header.cols; }
+    uint64_t keyframe_every() const { return header.keyframe_every; }
+    int64_t seed() const { return header.seed; }
+    uint64_t first_generation() const { return index[0].first_generation; }
+
+    // board of generation g, rows() x cols(): the keyframe at or before it,
+    // then the deltas up to it
+    template <typename T>
+    bool seek(unsigned long g, Grid<T> &board) const {
+        // the last block starting at or before g
+        uint64_t lo = 0, hi = trailer.blocks;
+        while (hi - lo > 1) {
+            const uint64_t mid = (lo + hi) / 2;
+            (index[mid].first_generation <= g ? lo : hi) = mid;
+        }
+        if (index[lo].first_generation > g) {
+            std::cout << "Generation " << g << " was not recorded"
+                      << std::endl;
+            return false;
+        }
+
+        // the block must lie before the index, its frames hold at most a
+        // token and a literal per word, and deflate shrinks at most 1032:1
+        const uint64_t at = index[lo].offset, limit = trailer.index_offset;
+        const size_t words = header.rows * ((header.cols + 63) / 64);
+        record_block b;
+        if (at > limit || limit - at < sizeof(b)) {
+            std::cout << "Corrupted index at generation "
+                      << index[lo].first_generation << std::endl;
+            return false;
+        }
+        std::memcpy(&b, file.data() + at, sizeof(b));
+        if (b.stored_bytes > limit - at - sizeof(b) ||
+            b.raw_bytes % sizeof(uint64_t) != 0 ||
+            b.generations > header.keyframe_every ||
+            b.raw_bytes / sizeof(uint64_t) / (3 + 2 * words) >
+                b.generations ||
+            (!b.compressed && b.raw_bytes != b.stored_bytes) ||
+            b.raw_bytes / 1032 > b.stored_bytes) {
+            std::cout << "Corrupted block at generation "
+                      << index[lo].first_generation << std::endl;
+            return false;
+        }
+        const unsigned char *stored = reinterpret_cast<const unsigned char *>(
+            file.data() + at + sizeof(b));
+        std::vector<uint64_t> raw(b.raw_bytes / sizeof(uint64_t));
+        if (b.compressed) {
+#ifdef GOL_MINIZ
+            mz_ulong len = b.raw_bytes;
+            if (mz_uncompress(reinterpret_cast<unsigned char *>(raw.data()),
+                              &len, stored, b.stored_bytes) != MZ_OK ||
+                len != b.raw_bytes) {
+                std::cout << "Corrupted block at generation "
+                          << b.first_generation << std::endl;
+                return false;
+            }
+#else
+            std::cout << "Compressed recording, build with -DGOL_MINIZ"
+                      << std::endl;
+            return false;
+#endif
+        } else {
+            std::memcpy(raw.data(), stored, b.raw_bytes);
+        }
+
+        std::vector<uint64_t> cells(words, 0);
+        const uint64_t *p = raw.data(), *end = p + raw.size();
+        for (uint64_t f = 0; f < b.generations; ++f) {
+            if (end - p < 3 || uint64_t(end - p - 3) < p[2])
+                break;
+            const uint64_t generation = p[0], key = p[1], n = p[2];
+            if (key)
+                std::fill(cells.begin(), cells.end(), 0);
+            if (!rle_apply(p + 3, p + 3 + n, cells.data(), words))
+                break;
+            p += 3 + n;
+            if (generation == g) {
+                unpack_board(cells.data(), board);
+                return true;
+            }
+        }
+        std::cout << "Generation " << g << " was not recorded" << std::endl;
+        return false;
+    }
+};
+
+#endif
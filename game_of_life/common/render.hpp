@@ -0,0 +1,180 @@
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "grid.hpp"
+
+//
+// prints the boards on a thread of its own, off the critical path: the
+// simulation hands over a copy of the board, into one of a few preallocated
+// frames, and goes on. While a frame waits to be printed the boards handed
+// over are not copied at all, so the copies follow the printing rate and a
+// slow terminal costs frames, not generations; the last board, if skipped,
+// is copied once the simulation is over. Each frame is formatted in a
+// single string and written at once, followed by the 50 ms pause of the
+// old print().
+//
+
+template <typename T>
+inline void copy_cells(Grid<T> &dst, const Grid<T> &src) {
+    for (long i = 0; i < src.rows(); ++i)
+        std::memcpy(static_cast<void *>(dst[i]), src[i],
+                    src.cols() * sizeof(T));
+}
+
+inline void copy_cells(bitboard &dst, const bitboard &src) { dst = src; }
+
+template <typename T>
+inline bool alive(const Grid<T> &board, long i, long j) {
+    return board[i][j] != 0;
+}
+
+inline bool alive(const bitboard &board, long i, long j) {
+    return board.get(i, j);
+}
+
+template <typename BOARD>
+class renderer {
+   private:
+    struct frame {
+        BOARD board;
+        unsigned long generation;
+    };
+
+    std::vector<frame> frames;
+    std::vector<int> free_frames;
+    std::deque<int> ready; // in generation order
+    std::mutex m;
+    std::condition_variable cv;
+    bool done;
+    unsigned long generations; // for the "k/n" header, 0 for none
+    unsigned long submitted;
+    bool behind; // the last board submitted was not copied
+    const BOARD &last; // the last generation, once the simulation is over
+    std::thread printer;
+
+    // the frame of the board of the given generation, ready to print
+    void hand_over(int f, const BOARD &board, unsigned long generation) {
+        copy_cells(frames[f].board, board);
+        frames[f].generation = generation;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            ready.push_back(f);
+        }
+        cv.notify_one();
+    }
+
+    void print(const frame &f, std::string &text) const {
+        const BOARD &board = f.board;
+        const long rows = board.rows(), cols = board.cols();
+        const std::string border(cols + 2, '-');
+
+        text.clear();
+        if (generations > 0)
+            text += std::to_string(f.generation) + "/" +
+                    std::to_string(generations) + "\n";
+        text += border + "\n";
+        for (long i = 0; i < rows; ++i) {
+            text += '|';
+            for (long j = 0; j < cols; ++j)
+                text += alive(board, i, j) ? '*' : ' ';
+            text += "|\n";
+        }
+        text += border + "\n";
+        std::cout.write(text.data(), text.size());
+        std::cout.flush();
+    }
+
+    void run() {
+        std::string text;
+        std::unique_lock<std::mutex> lock(m);
+        while (true) {
+            cv.wait(lock, [this] { return done || !ready.empty(); });
+            if (ready.empty())
+                return;
+            const int f = ready.front();
+            ready.pop_front();
+            lock.unlock();
+
+            print(frames[f], text);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            lock.lock();
+            free_frames.push_back(f);
+            cv.notify_one();
+        }
+    }
+
+   public:
+    // frames are copies of board, which holds the last generation once
+    // the simulation is over; with generations the frames are headed by
+    // "k/generations"
+    renderer(const BOARD &board, unsigned long generations = 0,
+             int n_frames = 2)
+        : done(false), generations(generations), submitted(0),
+          behind(false), last(board) {
+        for (int f = 0; f < n_frames; ++f) {
+            frames.push_back({board, 0});
+            free_frames.push_back(f);
+        }
+        printer = std::thread(&renderer::run, this);
+    }
+
+    renderer(const renderer &) = delete;
+    renderer &operator=(const renderer &) = delete;
+
+    // prints the frames already handed over and the last generation,
+    // then stops
+    ~renderer() {
+        if (behind) {
+            int f;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                if (!ready.empty()) {
+                    f = ready.back();
+                    ready.pop_back();
+                } else {
+                    cv.wait(lock, [this] { return !free_frames.empty(); });
+                    f = free_frames.back();
+                    free_frames.pop_back();
+                }
+            }
+            hand_over(f, last, submitted);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            done = true;
+        }
+        cv.notify_one();
+        printer.join();
+    }
+
+    // called by the simulation at the end of every generation, never
+    // blocks on the printing
+    void submit(const BOARD &board) {
+        int f;
+        unsigned long generation;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            generation = ++submitted;
+            behind = !ready.empty() || free_frames.empty();
+            if (behind)
+                return;
+            f = free_frames.back();
+            free_frames.pop_back();
+        }
+        hand_over(f, board, generation);
+    }
+};
+
+#endif
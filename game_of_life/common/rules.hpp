@@ -0,0 +1,124 @@
+#ifndef RULES_HPP
+#define RULES_HPP
+
+#include <cctype>
+#include <string>
+
+//
+// Life-like rules, as B/S rulestrings: bit n of birth (survive) is set if a
+// dead (alive) cell with n alive neighbours is alive in the next
+// generation.
+//
+// The known rules are types with the masks as template arguments, so that
+// the kernels instantiated on them fold the rule into a few branch-free
+// operations; any other rule runs on table_rule, a lookup per cell.
+// with_rule() maps the rule parsed at startup to its type.
+//
+
+struct rule_spec {
+    unsigned birth, survive;
+
+    bool operator==(const rule_spec &other) const {
+        return birth == other.birth && survive == other.survive;
+    }
+    bool operator!=(const rule_spec &other) const { return !(*this == other); }
+
+    std::string name() const {
+        std::string s = "B";
+        for (int n = 0; n <= 8; ++n)
+            if (birth >> n & 1)
+                s += char('0' + n);
+        s += "/S";
+        for (int n = 0; n <= 8; ++n)
+            if (survive >> n & 1)
+                s += char('0' + n);
+        return s;
+    }
+};
+
+template <unsigned BIRTH, unsigned SURVIVE>
+struct fixed_rule {
+    static constexpr rule_spec spec{BIRTH, SURVIVE};
+
+    // alive is 0 or 1: -alive selects the survive mask
+    template <typename T>
+    static T next(T alive, T alive_neighbours) {
+        const unsigned mask = (BIRTH & ~(0u - unsigned(alive))) |
+                              (SURVIVE & (0u - unsigned(alive)));
+        return (mask >> alive_neighbours) & 1;
+    }
+};
+
+// B3/S23: alive with 3 neighbours, or with 2 if already alive
+template <>
+struct fixed_rule<0x008, 0x00c> {
+    static constexpr rule_spec spec{0x008, 0x00c};
+
+    template <typename T>
+    static T next(T alive, T alive_neighbours) {
+        return (alive_neighbours | alive) == 3;
+    }
+};
+
+using life = fixed_rule<0x008, 0x00c>;          // B3/S23
+using highlife = fixed_rule<0x048, 0x00c>;      // B36/S23
+using seeds = fixed_rule<0x004, 0x000>;         // B2/S
+using day_and_night = fixed_rule<0x1c8, 0x1d8>; // B3678/S34678
+
+struct table_rule {
+    rule_spec spec;
+    unsigned char table[2][9];
+
+    table_rule(const rule_spec &spec) : spec(spec) {
+        for (int n = 0; n <= 8; ++n) {
+            table[0][n] = spec.birth >> n & 1;
+            table[1][n] = spec.survive >> n & 1;
+        }
+    }
+
+    template <typename T>
+    T next(T alive, T alive_neighbours) const {
+        return table[alive != 0][alive_neighbours];
+    }
+};
+
+// "B3/S23" (any case, either order) or the S/B form "23/3"
+inline bool parse_rule(const std::string &s, rule_spec &rule) {
+    rule = {0, 0};
+    const auto slash = s.find('/');
+    if (slash == std::string::npos)
+        return false;
+    std::string parts[2] = {s.substr(0, slash), s.substr(slash + 1)};
+    for (auto &part : parts) {
+        unsigned *mask = nullptr;
+        for (char c : part) {
+            c = toupper(c);
+            if (c == 'B' || c == 'S') {
+                mask = c == 'B' ? &rule.birth : &rule.survive;
+            } else if (c >= '0' && c <= '8') {
+                if (mask == nullptr) // S/B: survive first
+                    mask = &part == &parts[0] ? &rule.survive : &rule.birth;
+                *mask |= 1u << (c - '0');
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// f(rule) with the type of the rule: fixed for the known ones
+template <typename F>
+auto with_rule(const rule_spec &rule, F f) {
+    if (rule == life::spec)
+        return f(life{});
+    if (rule == highlife::spec)
+        return f(highlife{});
+    if (rule == seeds::spec)
+        return f(seeds{});
+    if (rule == day_and_night::spec)
+        return f(day_and_night{});
+    return f(table_rule(rule));
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+//
+// row kernels on uint8 cells (0 or 1): computes out[j], 0 <= j < n, from the
+// row above, the row itself and the row below. Cells j-1 and j+1 must be
+// readable, so callers pass a pointer to column 1 and n = cols - 2.
+//
+// B3/S23 is computed branch-free as (neighbours | alive) == 3: it holds for
+// 3 neighbours, or for 2 neighbours of an alive cell.
+//
+
+using row_kernel_t = void (*)(const uint8_t *up, const uint8_t *mid,
+                              const uint8_t *down, uint8_t *out, size_t n);
+
+// B3/S23 as computed by the int workers, used by the self check
+static inline void row_reference(const uint8_t *up, const uint8_t *mid,
+                                 const uint8_t *down, uint8_t *out, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        int alive_neighbours =
+            up[j - 1] + up[j] + up[j + 1] +
+            mid[j - 1] + mid[j + 1] +
+            down[j - 1] + down[j] + down[j + 1];
+        if (alive_neighbours < 2 || alive_neighbours > 3)
+            out[j] = 0;
+        else if (alive_neighbours == 3)
+            out[j] = 1;
+        else
+            out[j] = mid[j];
+    }
+}
+
+static inline void row_scalar_tail(const uint8_t *up, const uint8_t *mid,
+                                   const uint8_t *down, uint8_t *out,
+                                   size_t from, size_t n) {
+    for (size_t j = from; j < n; ++j) {
+        uint8_t alive_neighbours =
+            up[j - 1] + up[j] + up[j + 1] +
+            mid[j - 1] + mid[j + 1] +
+            down[j - 1] + down[j] + down[j + 1];
+        out[j] = (alive_neighbours | mid[j]) == 3;
+    }
+}
+
+static inline void row_scalar(const uint8_t *up, const uint8_t *mid,
+                              const uint8_t *down, uint8_t *out, size_t n) {
+    row_scalar_tail(up, mid, down, out, 0, n);
+}
+
+__attribute__((target("sse2")))
+static inline void row_sse2(const uint8_t *up, const uint8_t *mid,
+                            const uint8_t *down, uint8_t *out, size_t n) {
+    const __m128i three = _mm_set1_epi8(3), one = _mm_set1_epi8(1);
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+#define LD(p) _mm_loadu_si128((const __m128i *)(p))
+        __m128i sum = _mm_add_epi8(
+            _mm_add_epi8(_mm_add_epi8(LD(up + j - 1), LD(up + j)),
+                         _mm_add_epi8(LD(up + j + 1), LD(mid + j - 1))),
+            _mm_add_epi8(_mm_add_epi8(LD(mid + j + 1), LD(down + j - 1)),
+                         _mm_add_epi8(LD(down + j), LD(down + j + 1))));
+        __m128i next = _mm_cmpeq_epi8(_mm_or_si128(sum, LD(mid + j)), three);
+#undef LD
+        _mm_storeu_si128((__m128i *)(out + j), _mm_and_si128(next, one));
+    }
+    row_scalar_tail(up, mid, down, out, j, n);
+}
+
+__attribute__((target("avx2")))
+static inline void row_avx2(const uint8_t *up, const uint8_t *mid,
+                            const uint8_t *down, uint8_t *out, size_t n) {
+    const __m256i three = _mm256_set1_epi8(3), one = _mm256_set1_epi8(1);
+    size_t j = 0;
+    for (; j + 32 <= n; j += 32) {
+#define LD(p) _mm256_loadu_si256((const __m256i *)(p))
+        __m256i sum = _mm256_add_epi8(
+            _mm256_add_epi8(_mm256_add_epi8(LD(up + j - 1), LD(up + j)),
+                            _mm256_add_epi8(LD(up + j + 1), LD(mid + j - 1))),
+            _mm256_add_epi8(_mm256_add_epi8(LD(mid + j + 1), LD(down + j - 1)),
+                            _mm256_add_epi8(LD(down + j), LD(down + j + 1))));
+        __m256i next =
+            _mm256_cmpeq_epi8(_mm256_or_si256(sum, LD(mid + j)), three);
+#undef LD
+        _mm256_storeu_si256((__m256i *)(out + j), _mm256_and_si256(next, one));
+    }
+    row_scalar_tail(up, mid, down, out, j, n);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline void row_avx512(const uint8_t *up, const uint8_t *mid,
+                              const uint8_t *down, uint8_t *out, size_t n) {
+    const __m512i three = _mm512_set1_epi8(3);
+    size_t j = 0;
+    for (; j + 64 <= n; j += 64) {
+#define LD(p) _mm512_loadu_si512((const void *)(p))
+        __m512i sum = _mm512_add_epi8(
+            _mm512_add_epi8(_mm512_add_epi8(LD(up + j - 1), LD(up + j)),
+                            _mm512_add_epi8(LD(up + j + 1), LD(mid + j - 1))),
+            _mm512_add_epi8(_mm512_add_epi8(LD(mid + j + 1), LD(down + j - 1)),
+                            _mm512_add_epi8(LD(down + j), LD(down + j + 1))));
+        __mmask64 next =
+            _mm512_cmpeq_epi8_mask(_mm512_or_si512(sum, LD(mid + j)), three);
+#undef LD
+        _mm512_storeu_si512((void *)(out + j), _mm512_maskz_set1_epi8(next, 1));
+    }
+    row_scalar_tail(up, mid, down, out, j, n);
+}
+
+struct row_kernel {
+    const char *name;
+    row_kernel_t fn;
+};
+
+// every kernel the running cpu supports, best first; scalar is always last
+static inline std::vector<row_kernel> supported_row_kernels() {
+    std::vector<row_kernel> kernels;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+        kernels.push_back({"avx512", row_avx512});
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", row_avx2});
+    if (__builtin_cpu_supports("sse2"))
+        kernels.push_back({"sse2", row_sse2});
+    kernels.push_back({"scalar", row_scalar});
+    return kernels;
+}
+
+// picked once at startup from CPUID, GOL_SIMD=<name> forces a kernel
+static inline row_kernel select_row_kernel() {
+    auto kernels = supported_row_kernels();
+    if (const char *force = getenv("GOL_SIMD"))
+        for (auto &k : kernels)
+            if (std::string(force) == k.name)
+                return k;
+    return kernels.front();
+}
+
+// checks every supported kernel against row_reference on random rows,
+// lengths cover the vector bodies and all the scalar tails
+static inline bool row_kernels_self_check() {
+    const size_t max_n = 3 * 64 + 63;
+    std::vector<uint8_t> rows[3], expected(max_n), got(max_n);
+    unsigned int state = 12345;
+    for (auto &r : rows) {
+        r.resize(max_n + 2);
+        for (auto &c : r) {
+            state = state * 1103515245 + 12345;
+            c = (state >> 16) & 1;
+        }
+    }
+    for (auto &k : supported_row_kernels())
+        for (size_t n = 1; n <= max_n; ++n) {
+            row_reference(&rows[0][1], &rows[1][1], &rows[2][1], &expected[0], n);
+            k.fn(&rows[0][1], &rows[1][1], &rows[2][1], &got[0], n);
+            for (size_t j = 0; j < n; ++j)
+                if (expected[j] != got[j])
+                    return false;
+        }
+    return true;
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "cycle.hpp"
+
+//
+// population statistics of a generation: live cells, births, deaths and
+// the bounding box of the live cells. The kernels count them while they
+// write the new cells, in a pop_stats of their own, and whoever ends the
+// generation (the drain, the last thread at the barrier) adds them up.
+// The same slots carry the Zobrist hash of the cells that flipped, for the
+// cycle detection, computed in the same sweep.
+//
+
+// a cache line each, so that workers never share one
+struct alignas(64) pop_stats {
+    long alive, births, deaths;
+    long top, bottom, left, right; // empty box if bottom < top
+    uint64_t flips; // zobrist keys of the cells that changed
+
+    pop_stats() { clear(); }
+
+    void clear() {
+        alive = births = deaths = 0;
+        top = left = LONG_MAX;
+        bottom = right = -1;
+        flips = 0;
+    }
+
+    void add(const pop_stats &other) {
+        alive += other.alive;
+        births += other.births;
+        deaths += other.deaths;
+        top = std::min(top, other.top);
+        bottom = std::max(bottom, other.bottom);
+        left = std::min(left, other.left);
+        right = std::max(right, other.right);
+        flips ^= other.flips;
+    }
+
+    // out[j] = next(j) for j in [from, to) of row i, counting the new
+    // cells against the old ones in mid, both 0 or 1. The counts are kept
+    // in T, as wide as the cells so that the loop vectorizes at the width
+    // of the plain one, over blocks too short to overflow it; the ends of
+    // the live cells are searched afterwards, from both sides of the row.
+    // With cols > 0 the cells that flipped, cell i * cols + j, are hashed
+    // as well: the count of the flips of a block tells whether there is
+    // anything to hash, and the block is still in L1 when it is
+    template <typename T, typename NEXT>
+    void sweep_row(long i, const T *mid, T *__restrict out, long from,
+                   long to, NEXT next, long cols = 0) {
+        static_assert(sizeof(T) >= 2, "counts of a block overflow T");
+        const long block = cols > 0 ? 256 : 8192;
+        long row_alive = 0, changed = 0, delta = 0;
+        for (long j0 = from; j0 < to; j0 += block) {
+            const long n = std::min(block, to - j0);
+            T a = 0, x = 0, d = 0;
+            for (T jj = 0; jj < T(n); ++jj) {
+                const long j = j0 + jj;
+                const T cell = next(j);
+                out[j] = cell;
+                a += cell;
+                x += cell ^ mid[j]; // births + deaths
+                d += cell - mid[j]; // births - deaths
+            }
+            row_alive += a;
+            changed += x;
+            delta += d;
+            if (cols > 0 && x > 0)
+                flips ^= block_flips(uint64_t(i) * cols + j0, mid + j0,
+                                     out + j0, n, x);
+        }
+        long lo = from, hi = to - 1;
+        if (row_alive > 0) {
+            while (!out[lo])
+                ++lo;
+            while (!out[hi])
+                --hi;
+        }
+        add_row(i, row_alive, (changed + delta) / 2, (changed - delta) / 2,
+                lo, hi);
+    }
+
+    // the counts of row i, its live cells spanning columns lo to hi
+    void add_row(long i, long row_alive, long row_births, long row_deaths,
+                 long lo, long hi) {
+        alive += row_alive;
+        births += row_births;
+        deaths += row_deaths;
+        if (row_alive > 0) {
+            top = std::min(top, i);
+            bottom = std::max(bottom, i);
+            left = std::min(left, lo);
+            right = std::max(right, hi);
+        }
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const pop_stats &s) {
+    os << s.alive << " alive, " << s.births << " births, " << s.deaths
+       << " deaths, ";
+    if (s.bottom < s.top)
+        return os << "empty";
+    return os << "box rows " << s.top << "-" << s.bottom << " cols "
+              << s.left << "-" << s.right;
+}
+
+// the accumulators of nw workers: a worker takes one with claim() the
+// first time it computes, combine() sums and clears them at the end of
+// the generation. The workers count the cells if counting() and hash the
+// flips if hashing(), end_generation() prints the counts and feeds the
+// hash to the cycle detector
+class population {
+   private:
+    std::vector<pop_stats> slots;
+    std::atomic<int> claimed;
+    unsigned long generation;
+    bool counts;
+    cycle_detector cycles;
+    bool stop;
+
+   public:
+    population(int nw, bool counts = true,
+               cycle_detector cycles = cycle_detector())
+        : slots(nw), claimed(0), generation(0), counts(counts),
+          cycles(cycles), stop(false) {}
+
+    bool counting() const { return counts; }
+    bool hashing() const { return cycles.enabled(); }
+    bool enabled() const { return counting() || hashing(); }
+
+    pop_stats &claim() { return slots[claimed++ % slots.size()]; }
+    pop_stats &slot(int w) { return slots[w]; }
+
+    pop_stats combine() {
+        pop_stats total;
+        for (auto &s : slots) {
+            total.add(s);
+            s.clear();
+        }
+        return total;
+    }
+
+    // combine() at the end of a generation, with one line about it if
+    // counting; true once the run can stop, at a cycle
+    bool end_generation() {
+        const pop_stats total = combine();
+        ++generation;
+        if (counts)
+            std::cout << "Generation " << generation << ": " << total
+                      << std::endl;
+        if (hashing() && !stop)
+            stop = cycles.step(total.flips);
+        return stop;
+    }
+
+    // whether end_generation() has found the end of the run
+    bool stopped() const { return stop; }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef TILED_HPP
+#define TILED_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "grid.hpp"
+#include "simd.hpp"
+
+//
+// temporal blocking: a tile is copied together with a ghost zone of k cells
+// per side into a private buffer, advanced k generations there (the valid
+// region shrinks by one cell per generation) and written back. Each tile
+// then streams the board from memory once every k generations instead of
+// once per generation, at the price of recomputing the ghost zones.
+//
+// Cells outside the inner board (the dead border and beyond) are loaded as
+// dead and never computed, so the border stays dead as in the single
+// generation kernels.
+//
+class tile_stepper {
+   private:
+    long k, tile_rows, tile_cols;
+    row_kernel_t kernel;
+    long width; // cells per row of the local buffers
+    std::vector<uint8_t> src, dst;
+
+   public:
+    tile_stepper(long k, long tile_rows, long tile_cols)
+        : k(k), tile_rows(tile_rows), tile_cols(tile_cols),
+          kernel(select_row_kernel().fn), width(tile_cols + 2 * k),
+          src((tile_rows + 2 * k) * width), dst(src.size()) {}
+
+    long generations() const { return k; }
+    long rows() const { return tile_rows; }
+    long cols() const { return tile_cols; }
+
+    // future[r0, r1) x [c0, c1) = board advanced by k generations, where
+    // the tile is at most tile_rows x tile_cols and inside the inner board
+    void advance(const Grid<uint8_t> &board, Grid<uint8_t> &future,
+                 long r0, long r1, long c0, long c1) {
+        const long h = (r1 - r0) + 2 * k, w = (c1 - c0) + 2 * k;
+        const long top = r0 - k, left = c0 - k; // global coords of (0, 0)
+
+        // load the tile and its ghost zone, dead outside the board
+        const long jl = std::max(0L, left), jh = std::min(board.cols(), left + w);
+        for (long li = 0; li < h; ++li) {
+            uint8_t *row = &src[li * width];
+            const long gi = top + li;
+            std::fill(row, row + w, 0);
+            if (gi >= 0 && gi < board.rows() && jl < jh)
+                std::memcpy(row + (jl - left), board[gi] + jl, jh - jl);
+        }
+        std::copy(src.begin(), src.begin() + h * width, dst.begin());
+
+        // only the inner board is ever computed
+        const long i_lo = 1 - top, i_hi = board.rows() - 1 - top;
+        const long j_lo = 1 - left, j_hi = board.cols() - 1 - left;
+        for (long s = 1; s <= k; ++s) {
+            const long lo = std::max(s, j_lo), hi = std::min(w - s, j_hi);
+            const long last = std::min(h - s, i_hi);
+            for (long li = std::max(s, i_lo); hi > lo && li < last; ++li)
+                kernel(&src[(li - 1) * width + lo], &src[li * width + lo],
+                       &src[(li + 1) * width + lo], &dst[li * width + lo],
+                       hi - lo);
+            src.swap(dst);
+        }
+
+        // the tile itself is now k generations ahead
+        for (long i = r0; i < r1; ++i)
+            std::memcpy(future[i] + c0, &src[(i - top) * width + k], c1 - c0);
+    }
+};
+
+#endif
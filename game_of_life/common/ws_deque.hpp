@@ -0,0 +1,87 @@
+#ifndef WS_DEQUE_HPP
+#define WS_DEQUE_HPP
+
+#include <atomic>
+#include <memory>
+
+//
+// Chase-Lev work-stealing deque of task ids (>= 0): the owner pushes and
+// pops at the bottom, thieves take from the top. The capacity is fixed and
+// must bound the tasks held at any time; the indices only grow, so a
+// drained deque can be refilled without resetting it. Memory orders follow
+// Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for
+// Weak Memory Models" (PPoPP 2013).
+//
+class ws_deque {
+   public:
+    static constexpr long EMPTY = -1;
+    static constexpr long ABORT = -2; // lost a race, worth retrying
+
+   private:
+    alignas(64) std::atomic<long> top;
+    alignas(64) std::atomic<long> bottom;
+    long capacity;
+    std::unique_ptr<std::atomic<long>[]> tasks;
+
+   public:
+    ws_deque(long capacity)
+        : top(0), bottom(0), capacity(capacity > 0 ? capacity : 1),
+          tasks(new std::atomic<long>[this->capacity]) {}
+
+    ws_deque(const ws_deque &) = delete;
+    ws_deque &operator=(const ws_deque &) = delete;
+
+    // owner only
+    void push(long task) {
+        const long b = bottom.load(std::memory_order_relaxed);
+        tasks[b % capacity].store(task, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // owner only
+    long pop() {
+        const long b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = top.load(std::memory_order_relaxed);
+        long task = EMPTY;
+        if (t <= b) {
+            task = tasks[b % capacity].load(std::memory_order_relaxed);
+            if (t == b) {
+                // last task, race against the thieves
+                if (!top.compare_exchange_strong(t, t + 1,
+                                                 std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed))
+                    task = EMPTY;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // any thread
+    long steal() {
+        long t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const long b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return EMPTY;
+        const long task = tasks[t % capacity].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+            return ABORT;
+        return task;
+    }
+
+    // tasks held, approximate when read by a thief
+    long size() const {
+        const long n = bottom.load(std::memory_order_relaxed) -
+                       top.load(std::memory_order_relaxed);
+        return n > 0 ? n : 0;
+    }
+};
+
+#endif
@@ -3,7 +3,9 @@
 #include <iostream>
 #include <thread>
 
-int count_alive_neighbours(bool **board, size_t row, size_t col, size_t rows, size_t cols) {
+#include "common/grid.hpp"
+
+int count_alive_neighbours(const Grid<bool> &board, size_t row, size_t col, size_t rows, size_t cols) {
     int n_alive{0};
 
     for (int i = -1; i <= 1; ++i)
@@ -24,7 +26,7 @@ bool compute_future(bool alive, int alive_neighbours) {
         return alive;
 }
 
-void update(bool **board, bool **future, size_t rows, size_t cols) {
+void update(const Grid<bool> &board, Grid<bool> &future, size_t rows, size_t cols) {
     for (size_t i = 1; i < rows - 1; ++i) {
         #pragma GCC ivdep
         for (size_t j = 1; j < cols - 1; ++j) {
@@ -34,7 +36,7 @@ void update(bool **board, bool **future, size_t rows, size_t cols) {
     }
 }
 
-void print(bool **board, size_t rows, size_t cols) {
+void print(const Grid<bool> &board, size_t rows, size_t cols) {
     std::string border(cols + 2, '-');
 
     std::cout << border << std::endl;
@@ -54,12 +56,7 @@ int main(int argc, char const *argv[]) {
     const unsigned long generations{1000};
 
     // boards allocation
-    bool **board = new bool*[rows];
-    bool **future = new bool*[rows];
-    for (size_t i = 0; i < rows; ++i) {
-        board[i] = new bool[cols];
-        future[i] = new bool[cols];
-    }
+    Grid<bool> board(rows, cols), future(rows, cols);
 
     // board initialization
     std::srand(std::time(nullptr));
@@ -82,12 +79,5 @@ int main(int argc, char const *argv[]) {
         print(board, rows, cols);
     }
 
-    for (size_t i = 0; i < rows; ++i) {
-        delete[] board[i];
-        delete[] future[i];
-    }
-    delete[] board;
-    delete[] future;
-
     return 0;
 }
@@ -0,0 +1,192 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../common/grid.hpp"
+#include "../common/init.hpp"
+#include "../common/options.hpp"
+#include "../par_dynamic/BLcode.hpp"
+#include "../par_dynamic/queue.cpp"
+#include "hashlife.hpp"
+
+using namespace std;
+
+// tasks to be computed: a batch of nodes whose results are independent
+class NodeSource : public Source<pair<int, node *>> {
+   private:
+    node **nodes;
+    size_t n, i;
+
+   public:
+    NodeSource(node **nodes, size_t n) : nodes(nodes), n(n), i(0) {}
+
+    pair<int, node *> next() {
+        pair<int, node *> next{i, nodes[i]};
+        ++i;
+        return next;
+    }
+
+    bool hasNext() {
+        return i < n;
+    }
+};
+
+// business logic to compute a task: the RESULT of a node
+class ResultWorker : public Worker<pair<int, node *>, pair<int, node *>> {
+   private:
+    hashlife &life;
+
+   public:
+    ResultWorker(hashlife &life) : life(life) {}
+
+    pair<int, node *> compute(pair<int, node *> task) {
+        return {task.first, life.result(task.second)};
+    }
+};
+
+// processing the results: put them back in place of their nodes
+class ResultDrain : public Drain<pair<int, node *>, bool> {
+   private:
+    node **nodes;
+    size_t remaining;
+
+   public:
+    ResultDrain(node **nodes, size_t n) : nodes(nodes), remaining(n) {}
+
+    /**
+     * par x:  index and result of a node
+     * return: true when the whole batch is done
+     */
+    bool process(pair<int, node *> x) {
+        nodes[x.first] = x.second;
+        return --remaining == 0;
+    }
+};
+
+void print(const Grid<uint8_t> &board) {
+    string border(board.cols() + 2, '-');
+
+    cout << border << endl;
+    for (long i = 0; i < board.rows(); ++i) {
+        cout << '|';
+        for (long j = 0; j < board.cols(); ++j)
+            cout << (board[i][j] ? '*' : ' ');
+        cout << '|' << endl;
+    }
+    cout << border << endl;
+}
+
+int main(int argc, char const *argv[]) {
+    if (argc < 6) {
+        cout << "Usage is " << argv[0]
+             << " rows cols generations seed nw"
+             << " [--step-log=10 --max-nodes=4000000 --print]"
+             << " [--load=pattern] [--save=pattern] [--density=0.5]" << endl
+             << "the universe is the unbounded plane, there is no dead"
+             << " border; --print, --save" << endl
+             << "and the population cover the rows x cols window of it"
+             << endl;
+        return -1;
+    }
+
+    const size_t rows = atol(argv[1]);
+    const size_t cols = atol(argv[2]);
+    const unsigned long generations = atol(argv[3]);
+    const int seed = atoi(argv[4]);
+    const int nw = atoi(argv[5]);
+    const options opts(argc, argv, 6);
+    const int step_log = opts.get("step-log", 10L);
+    const size_t max_nodes = opts.get("max-nodes", 4000000L);
+    const double density = atof(opts.get("density", "0.5").c_str());
+    const string load = opts.get("load", ""), save = opts.get("save", "");
+    if (nw < 1) {
+        cout << "nw must be at least 1" << endl;
+        return -1;
+    }
+    if (step_log < 0 || step_log > hashlife::MAX_STEP_LOG) {
+        cout << "--step-log must be between 0 and " << hashlife::MAX_STEP_LOG
+             << endl;
+        return -1;
+    }
+
+    // board initialization, same as the dense engines
+    Grid<uint8_t> board(rows, cols);
+    if (!init_board(board, load, seed, false, nw, density))
+        return -1;
+
+    hashlife life;
+    life.load(board);
+
+    // with more than one worker, the independent subquadrants of the root
+    // are evaluated by a farm of resident workers
+    const pair<int, node *> EOS{-1, nullptr};
+    syque<pair<int, node *>> t_queue, r_queue;
+    vector<thread *> tids;
+    function<void(node **, size_t)> eval = [&](node **nodes, size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            nodes[i] = life.result(nodes[i]);
+    };
+    if (nw > 1) {
+        auto body = [&](ResultWorker w) {
+            while (true) {
+                auto t = t_queue.pop();
+                if (t == EOS)
+                    break;
+                r_queue.push(w.compute(t));
+            }
+        };
+        for (int i = 0; i < nw; i++)
+            tids.push_back(new thread(body, ResultWorker{life}));
+
+        eval = [&](node **nodes, size_t n) {
+            NodeSource s{nodes, n};
+            ResultDrain d{nodes, n};
+            while (s.hasNext())
+                t_queue.push(s.next());
+            while (!d.process(r_queue.pop()))
+                ;
+        };
+    }
+
+    auto t0 = chrono::system_clock::now();
+    auto step = [&] {
+        life.step(eval);
+        if (life.nodes() > max_nodes)
+            life.gc();
+    };
+    // jumps of 2^step_log generations, then the remainder in powers of two
+    unsigned long remaining = generations;
+    life.set_step_log(step_log);
+    for (; remaining >= (1UL << step_log); remaining -= 1UL << step_log)
+        step();
+    for (int k = step_log - 1; k >= 0; --k)
+        if (remaining & (1UL << k)) {
+            life.set_step_log(k);
+            step();
+        }
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+                       chrono::system_clock::now() - t0)
+                       .count();
+
+    for (size_t i = 0; i < tids.size(); i++)
+        t_queue.push(EOS);
+    for (auto t : tids)
+        t->join();
+
+    life.store(board);
+    if (opts.has("print"))
+        print(board);
+    if (!save.empty() && !save_pattern(save, board, life::spec))
+        return -1;
+    unsigned long alive = 0;
+    for (long i = 0; i < board.rows(); ++i)
+        for (long j = 0; j < board.cols(); ++j)
+            alive += board[i][j];
+    cout << "Population after " << generations << " generations is " << alive
+         << " on the board, " << life.population() << " on the plane ("
+         << life.nodes() << " nodes)" << endl;
+    cout << "Hashlife execution with " << nw << " threads took " << elapsed
+         << " msecs" << endl;
+    return 0;
+}
@@ -0,0 +1,345 @@
+#ifndef HASHLIFE_HPP
+#define HASHLIFE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "../common/grid.hpp"
+
+//
+// Hashlife (Gosper): the universe is a quadtree whose identical subtrees
+// are stored once (hash consing), and the RESULT of every node, i.e. its
+// centre advanced by 2^(level-2) generations, is memoized in the node.
+// Regular patterns then cost far less than rows * cols per generation.
+//
+// The universe is the unbounded plane: it matches the dense engines as
+// long as the pattern never reaches the dead border of the board.
+//
+
+// a square of 2^level cells per side, leaves (level 0) are single cells
+struct node {
+    node *nw, *ne, *sw, *se;
+    std::atomic<node *> result; // memoized RESULT, null until computed
+    uint64_t population;
+    int level;
+    bool marked; // garbage collection
+
+    node(node *nw, node *ne, node *sw, node *se, uint64_t population,
+         int level)
+        : nw(nw), ne(ne), sw(sw), se(se), result(nullptr),
+          population(population), level(level), marked(false) {}
+};
+
+class hashlife {
+   public:
+    static constexpr int MAX_LEVEL = 62;
+    // a step grows the root up to step_log + 5 levels
+    static constexpr int MAX_STEP_LOG = MAX_LEVEL - 5;
+
+   private:
+    struct children_hash {
+        size_t operator()(const node *n) const {
+            return hash(n->nw, n->ne, n->sw, n->se);
+        }
+    };
+    struct children_equal {
+        bool operator()(const node *a, const node *b) const {
+            return a->nw == b->nw && a->ne == b->ne &&
+                   a->sw == b->sw && a->se == b->se;
+        }
+    };
+
+    // the node store is split in shards, each with its own lock, so that
+    // parallel workers seldom contend on it
+    static constexpr size_t SHARDS = 64;
+    struct shard {
+        std::mutex lock;
+        std::unordered_set<node *, children_hash, children_equal> nodes;
+    };
+    shard shards[SHARDS];
+    std::atomic<size_t> n_nodes;
+
+    node *leaves[2];
+    node *empties[MAX_LEVEL + 1]; // empty node of each level
+    node *root;
+    int step_log;   // each step advances 2^step_log generations
+    long origin;    // board cell (i, j) is plane cell (i - origin, j - origin)
+
+    static size_t hash(const node *nw, const node *ne, const node *sw,
+                       const node *se) {
+        size_t h = reinterpret_cast<size_t>(nw);
+        h = h * 0x9e3779b97f4a7c15ULL + reinterpret_cast<size_t>(ne);
+        h = h * 0x9e3779b97f4a7c15ULL + reinterpret_cast<size_t>(sw);
+        h = h * 0x9e3779b97f4a7c15ULL + reinterpret_cast<size_t>(se);
+        return h ^ (h >> 29);
+    }
+
+    // centre of a node, one level down, not advanced
+    node *centre(node *n) {
+        return join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+    }
+
+    // base case: 4x4 cells to the centre 2x2 advanced by one generation
+    node *base(node *n) {
+        int c[4][4];
+        node *q[2][2] = {{n->nw, n->ne}, {n->sw, n->se}};
+        for (int y = 0; y < 2; ++y)
+            for (int x = 0; x < 2; ++x) {
+                c[2 * y][2 * x] = q[y][x]->nw == leaves[1];
+                c[2 * y][2 * x + 1] = q[y][x]->ne == leaves[1];
+                c[2 * y + 1][2 * x] = q[y][x]->sw == leaves[1];
+                c[2 * y + 1][2 * x + 1] = q[y][x]->se == leaves[1];
+            }
+        node *next[2][2];
+        for (int y = 1; y < 3; ++y)
+            for (int x = 1; x < 3; ++x) {
+                int alive_neighbours = -c[y][x];
+                for (int i = -1; i <= 1; ++i)
+                    for (int j = -1; j <= 1; ++j)
+                        alive_neighbours += c[y + i][x + j];
+                next[y - 1][x - 1] =
+                    leaves[(alive_neighbours | c[y][x]) == 3];
+            }
+        return join(next[0][0], next[0][1], next[1][0], next[1][1]);
+    }
+
+    // true if all the cells are in the central quarter of the root, the
+    // pattern then cannot escape the RESULT of the root
+    bool centred(node *n) const {
+        return n->level >= 3 &&
+               n->population == n->nw->se->se->population +
+                                n->ne->sw->sw->population +
+                                n->sw->ne->ne->population +
+                                n->se->nw->nw->population;
+    }
+
+    // same universe, one level up
+    node *expand(node *n) {
+        node *e = empties[n->level - 1];
+        return join(join(e, e, e, n->nw), join(e, e, n->ne, e),
+                    join(e, n->sw, e, e), join(n->se, e, e, e));
+    }
+
+    node *build(const Grid<uint8_t> &board, int level, long y0, long x0) {
+        const long side = 1L << level;
+        if (y0 + origin >= board.rows() || y0 + origin + side <= 0 ||
+            x0 + origin >= board.cols() || x0 + origin + side <= 0)
+            return empties[level];
+        if (level == 0)
+            return leaves[board[y0 + origin][x0 + origin] != 0];
+        const long half = side / 2;
+        return join(build(board, level - 1, y0, x0),
+                    build(board, level - 1, y0, x0 + half),
+                    build(board, level - 1, y0 + half, x0),
+                    build(board, level - 1, y0 + half, x0 + half));
+    }
+
+    void write(Grid<uint8_t> &board, node *n, long y0, long x0) const {
+        const long side = 1L << n->level;
+        if (n->population == 0 ||
+            y0 + origin >= board.rows() || y0 + origin + side <= 0 ||
+            x0 + origin >= board.cols() || x0 + origin + side <= 0)
+            return;
+        if (n->level == 0) {
+            board[y0 + origin][x0 + origin] = 1;
+            return;
+        }
+        const long half = side / 2;
+        write(board, n->nw, y0, x0);
+        write(board, n->ne, y0, x0 + half);
+        write(board, n->sw, y0 + half, x0);
+        write(board, n->se, y0 + half, x0 + half);
+    }
+
+    void mark(node *n) {
+        if (n == nullptr || n->marked)
+            return;
+        n->marked = true;
+        mark(n->nw);
+        mark(n->ne);
+        mark(n->sw);
+        mark(n->se);
+    }
+
+   public:
+    hashlife() : n_nodes(0), root(nullptr), step_log(0), origin(0) {
+        leaves[0] = new node(nullptr, nullptr, nullptr, nullptr, 0, 0);
+        leaves[1] = new node(nullptr, nullptr, nullptr, nullptr, 1, 0);
+        empties[0] = leaves[0];
+        for (int l = 1; l <= MAX_LEVEL; ++l) {
+            node *e = empties[l - 1];
+            empties[l] = join(e, e, e, e);
+        }
+        root = empties[3];
+    }
+
+    ~hashlife() {
+        for (auto &s : shards)
+            for (node *n : s.nodes)
+                delete n;
+        delete leaves[0];
+        delete leaves[1];
+    }
+
+    hashlife(const hashlife &) = delete;
+    hashlife &operator=(const hashlife &) = delete;
+
+    // canonical node with the given children
+    node *join(node *nw, node *ne, node *sw, node *se) {
+        node key(nw, ne, sw, se, 0, 0);
+        shard &s = shards[hash(nw, ne, sw, se) % SHARDS];
+        std::unique_lock<std::mutex> lock(s.lock);
+        auto it = s.nodes.find(&key);
+        if (it != s.nodes.end())
+            return *it;
+        node *n = new node(nw, ne, sw, se,
+                           nw->population + ne->population +
+                           sw->population + se->population,
+                           nw->level + 1);
+        s.nodes.insert(n);
+        n_nodes++;
+        return n;
+    }
+
+    // the 9 overlapping subnodes, one level down, whose results tile the
+    // centre of n
+    std::array<node *, 9> subquadrants(node *n) {
+        return {n->nw,
+                join(n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw),
+                n->ne,
+                join(n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne),
+                join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw),
+                join(n->ne->sw, n->ne->se, n->se->nw, n->se->ne),
+                n->sw,
+                join(n->sw->ne, n->se->nw, n->sw->se, n->se->sw),
+                n->se};
+    }
+
+    // the 4 nodes built from the results of the 9 subquadrants
+    std::array<node *, 4> quadrants(const std::array<node *, 9> &r) {
+        return {join(r[0], r[1], r[3], r[4]), join(r[1], r[2], r[4], r[5]),
+                join(r[3], r[4], r[6], r[7]), join(r[4], r[5], r[7], r[8])};
+    }
+
+    // true if the result of a node takes two rounds of results, i.e. it
+    // advances 2^(level-2) generations; otherwise the second round only
+    // takes the centres
+    bool full_speed(const node *n) const { return n->level - 2 <= step_log; }
+
+    // centre of n advanced by 2^min(step_log, level-2) generations
+    node *result(node *n) {
+        node *r = n->result.load(std::memory_order_acquire);
+        if (r != nullptr)
+            return r;
+        if (n->population == 0)
+            r = empties[n->level - 1];
+        else if (n->level == 2)
+            r = base(n);
+        else {
+            std::array<node *, 9> sub = subquadrants(n);
+            for (auto &s : sub)
+                s = result(s);
+            std::array<node *, 4> q = quadrants(sub);
+            for (auto &s : q)
+                s = full_speed(n) ? result(s) : centre(s);
+            r = join(q[0], q[1], q[2], q[3]);
+        }
+        n->result.store(r, std::memory_order_release);
+        return r;
+    }
+
+    // the memoized results depend on the step size
+    void set_step_log(int k) {
+        if (k == step_log)
+            return;
+        step_log = k;
+        for (auto &s : shards)
+            for (node *n : s.nodes)
+                n->result.store(nullptr, std::memory_order_relaxed);
+    }
+
+    int get_step_log() const { return step_log; }
+
+    // advances the universe by 2^step_log generations; eval computes the
+    // results of a batch of independent nodes, possibly in parallel
+    void step(const std::function<void(node **, size_t)> &eval) {
+        while (root->level < step_log + 3 || !centred(root))
+            root = expand(root);
+        // one more level of margin around the pattern
+        root = expand(root);
+
+        std::array<node *, 9> sub = subquadrants(root);
+        eval(sub.data(), sub.size());
+        std::array<node *, 4> q = quadrants(sub);
+        if (full_speed(root))
+            eval(q.data(), q.size());
+        else
+            for (auto &s : q)
+                s = centre(s);
+        node *r = join(q[0], q[1], q[2], q[3]);
+        root->result.store(r, std::memory_order_release);
+        root = r;
+    }
+
+    void step() {
+        step([this](node **nodes, size_t n) {
+            for (size_t i = 0; i < n; ++i)
+                nodes[i] = result(nodes[i]);
+        });
+    }
+
+    // imports the board, the board centre is the centre of the plane
+    void load(const Grid<uint8_t> &board) {
+        int level = 3;
+        while ((1L << level) < std::max(board.rows(), board.cols()))
+            ++level;
+        origin = 1L << (level - 1);
+        root = build(board, level, -origin, -origin);
+    }
+
+    // exports the cells falling inside the board, the rest is dropped
+    void store(Grid<uint8_t> &board) const {
+        for (long i = 0; i < board.rows(); ++i)
+            std::fill(board[i], board[i] + board.cols(), 0);
+        const long side = 1L << root->level;
+        write(board, root, -side / 2, -side / 2);
+    }
+
+    uint64_t population() const { return root->population; }
+    size_t nodes() const { return n_nodes; }
+
+    // drops every node not reachable from the root, and the memoized
+    // results pointing to them
+    void gc() {
+        mark(root);
+        for (int l = 0; l <= MAX_LEVEL; ++l)
+            empties[l]->marked = true;
+        for (auto &s : shards)
+            for (node *n : s.nodes) {
+                node *r = n->result.load(std::memory_order_relaxed);
+                if (n->marked && r != nullptr && !r->marked)
+                    n->result.store(nullptr, std::memory_order_relaxed);
+            }
+        for (auto &s : shards)
+            for (auto it = s.nodes.begin(); it != s.nodes.end();) {
+                if ((*it)->marked) {
+                    (*it)->marked = false;
+                    ++it;
+                } else {
+                    delete *it;
+                    it = s.nodes.erase(it);
+                    n_nodes--;
+                }
+            }
+        leaves[0]->marked = leaves[1]->marked = false;
+    }
+};
+
+#endif
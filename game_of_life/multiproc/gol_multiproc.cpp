@@ -0,0 +1,223 @@
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "../common/grid.hpp"
+#include "../common/init.hpp"
+#include "../common/options.hpp"
+#include "../common/rules.hpp"
+#include "transport.hpp"
+
+using namespace std;
+
+// rows [first, last) of future; with torus the columns wrap inside each
+// row, the halo rows are left to the caller
+template <typename RULE>
+void update(const Grid<int> &board, Grid<int> &future, long first,
+            long last, bool torus, const RULE &rule) {
+    const long b = torus ? 0 : 1;
+    for (long i = first; i < last; ++i) {
+        const int *up = board[i - 1], *mid = board[i], *down = board[i + 1];
+        int *__restrict out = future[i];
+        for (long j = b; j < board.cols() - b; ++j) {
+            int alive_neighbours =
+                up[j - 1] + up[j] + up[j + 1] +
+                mid[j - 1] + mid[j + 1] +
+                down[j - 1] + down[j] + down[j + 1];
+            out[j] = rule.next(mid[j], alive_neighbours);
+        }
+        if (torus) {
+            out[-1] = out[board.cols() - 1];
+            out[board.cols()] = out[0];
+        }
+    }
+}
+
+// rows [from, to) of the board owned by band r of n
+void band_rows(long rows, int r, int n, long &from, long &to) {
+    from = rows * r / n;
+    to = rows * (r + 1) / n;
+}
+
+//
+// a worker process: its band lives in a private allocation, with the halo
+// rows above and below filled by the neighbouring bands through the
+// transport after every generation. The first and last row of the board
+// are the dead border unless on a torus, so they are never computed.
+//
+template <typename RULE>
+void run_band(const Grid<int> &initial, halo_transport &halo, int r, int n,
+              unsigned long generations, bool torus, const RULE &rule,
+              uint8_t *result) {
+    long from, to;
+    band_rows(initial.rows(), r, n, from, to);
+    const long band = to - from, cols = initial.cols();
+
+    Grid<int> board(band, cols, 1), future(band, cols, 1);
+    for (long i = -1; i <= band; ++i)
+        memcpy(board[i] - 1, initial[from + i] - 1,
+               (cols + 2) * sizeof(int));
+
+    // rows of the band that are not the dead border
+    const long first = torus || from > 0 ? 0 : 1;
+    const long last = torus || to < initial.rows() ? band : band - 1;
+
+    for (unsigned long it = 0; it < generations; ++it) {
+        update(board, future, first, last, torus, rule);
+        // whole rows, column halo included, so that corners are right
+        if (halo.has_up())
+            halo.send_up(future[0] - 1);
+        if (halo.has_down())
+            halo.send_down(future[band - 1] - 1);
+        if (halo.has_up())
+            halo.recv_up(future[-1] - 1);
+        if (halo.has_down())
+            halo.recv_down(future[band] - 1);
+        swap(board, future);
+    }
+
+    for (long i = 0; i < band; ++i)
+        for (long j = 0; j < cols; ++j)
+            result[(from + i) * cols + j] = board[i][j];
+}
+
+// the whole board in this process, to check the bands against
+template <typename RULE>
+void run_sequential(Grid<int> &board, unsigned long generations, bool torus,
+                    const RULE &rule) {
+    const long b = torus ? 0 : 1;
+    Grid<int> future(board.rows(), board.cols(), 1);
+    for (unsigned long it = 0; it < generations; ++it) {
+        update(board, future, b, board.rows() - b, torus, rule);
+        if (torus)
+            future.wrap();
+        swap(board, future);
+    }
+}
+
+int main(int argc, char const *argv[]) {
+    if (argc < 6) {
+        cout << "Usage is " << argv[0]
+             << " rows cols generations seed np [--torus] [--rule=B3/S23]"
+             << " [--load=pattern] [--save=pattern] [--density=0.5]"
+             << " [--verify]" << endl;
+        return -1;
+    }
+
+    const long rows = atol(argv[1]);
+    const long cols = atol(argv[2]);
+    const unsigned long generations = atol(argv[3]);
+    const int seed = atoi(argv[4]);
+    const int np = atoi(argv[5]);
+    const options opts(argc, argv, 6);
+    const bool torus = opts.has("torus");
+    const string load = opts.get("load", "");
+    const string save = opts.get("save", "");
+    const double density = atof(opts.get("density", "0.5").c_str());
+    const bool verify = opts.has("verify");
+    rule_spec rule;
+    if (!parse_rule(opts.get("rule", "B3/S23"), rule)) {
+        cout << "Invalid rule " << opts.get("rule", "") << endl;
+        return -1;
+    }
+    if (np < 1 || np > rows) {
+        cout << "np must be between 1 and the number of rows" << endl;
+        return -1;
+    }
+
+    // the initial board is built here and inherited by the children, each
+    // copies its band out of it
+    Grid<int> board(rows, cols, 1);
+    if (!init_board(board, load, seed, torus, 1, density))
+        return -1;
+    if (rule != life::spec)
+        cout << "Running " << rule.name() << endl;
+
+    shm_halo_transport halo(np, (cols + 2) * sizeof(int), torus);
+    if (!halo.ok())
+        return -1;
+    // the bands write their cells here when done
+    void *shared = mmap(nullptr, rows * cols, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        cout << "Cannot map the result board" << endl;
+        return -1;
+    }
+    uint8_t *result = static_cast<uint8_t *>(shared);
+
+    cout.flush();
+    auto t0 = chrono::system_clock::now();
+    vector<pid_t> children;
+    for (int r = 0; r < np; ++r) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            cout << "fork failed" << endl;
+            for (pid_t c : children)
+                kill(c, SIGKILL);
+            return -1;
+        }
+        if (pid == 0) {
+            halo.attach(r);
+            with_rule(rule, [&](const auto &rule) {
+                run_band(board, halo, r, np, generations, torus, rule,
+                         result);
+                return 0;
+            });
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+
+    // a band that dies leaves its neighbours waiting for its rows
+    bool failed = false;
+    for (size_t done = 0; done < children.size(); ++done) {
+        int status;
+        if (wait(&status) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            if (!failed)
+                for (pid_t c : children)
+                    kill(c, SIGKILL);
+            failed = true;
+        }
+    }
+    const long elapsed = chrono::duration_cast<chrono::milliseconds>(
+                             chrono::system_clock::now() - t0)
+                             .count();
+    if (failed) {
+        cout << "A worker process failed" << endl;
+        return -1;
+    }
+
+    Grid<int> final_board(rows, cols, 1);
+    for (long i = 0; i < rows; ++i)
+        for (long j = 0; j < cols; ++j)
+            final_board[i][j] = result[i * cols + j];
+    munmap(shared, rows * cols);
+
+    if (verify) {
+        with_rule(rule, [&](const auto &rule) {
+            run_sequential(board, generations, torus, rule);
+            return 0;
+        });
+        for (long i = 0; i < rows; ++i)
+            if (memcmp(board[i], final_board[i], cols * sizeof(int)) != 0) {
+                cout << "Row " << i << " differs from the sequential board"
+                     << endl;
+                return -1;
+            }
+        cout << "Same board as the sequential run" << endl;
+    }
+
+    if (!save.empty() && !save_pattern(save, final_board, rule))
+        return -1;
+
+    cout << "Multi-process execution with " << np << " processes took "
+         << elapsed << " msecs" << endl;
+    return 0;
+}
@@ -0,0 +1,215 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+//
+// halo exchange between the bands of a board: every band sends its first
+// and last row to the band above and the band below and receives theirs
+// into its halo rows. Messages between two bands arrive in order; a band
+// may run at most a generation ahead of its neighbours, which the
+// transports must buffer.
+//
+class halo_transport {
+   public:
+    virtual ~halo_transport() {}
+
+    // whether there is a band above (below) to exchange rows with
+    virtual bool has_up() const = 0;
+    virtual bool has_down() const = 0;
+
+    // row of bytes() bytes to the band above (below)
+    virtual void send_up(const void *row) = 0;
+    virtual void send_down(const void *row) = 0;
+
+    // next row from the band above (below), blocking until it arrives
+    virtual void recv_up(void *row) = 0;
+    virtual void recv_down(void *row) = 0;
+
+    virtual size_t bytes() const = 0;
+};
+
+//
+// single producer, single consumer ring of fixed size messages living in
+// shared memory: the counters only grow, and a side that finds the ring
+// empty (full) spins for a while, then sleeps on the futex of the counter
+// it waits for. The other side only makes the wake system call if the
+// waiting flag is up.
+//
+class shm_ring {
+   public:
+    static constexpr uint32_t SLOTS = 4;
+
+   private:
+    struct header {
+        alignas(64) std::atomic<uint32_t> head; // messages written
+        std::atomic<uint32_t> head_waiting;
+        alignas(64) std::atomic<uint32_t> tail; // messages read
+        std::atomic<uint32_t> tail_waiting;
+    };
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "the counters are shared between processes");
+
+    header *h;
+    char *slots;
+    size_t msg_bytes, slot_bytes;
+
+    static size_t slot_size(size_t msg_bytes) {
+        return (msg_bytes + 63) / 64 * 64;
+    }
+
+    // process shared futexes: no FUTEX_PRIVATE_FLAG
+    static void futex_wait(std::atomic<uint32_t> &word, uint32_t value) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT,
+                value, nullptr, nullptr, 0);
+    }
+
+    static void futex_wake(std::atomic<uint32_t> &word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE,
+                1, nullptr, nullptr, 0);
+    }
+
+    // until counter != value; the flag and the counter are seq_cst on
+    // both sides, so either the waker sees the flag or we see the counter
+    static void wait_change(std::atomic<uint32_t> &counter,
+                            std::atomic<uint32_t> &waiting, uint32_t value) {
+        for (int spins = 0; spins < 4096; ++spins)
+            if (counter.load(std::memory_order_acquire) != value)
+                return;
+        while (counter.load() == value) {
+            waiting.store(1);
+            if (counter.load() == value)
+                futex_wait(counter, value);
+            waiting.store(0);
+        }
+    }
+
+    static void publish(std::atomic<uint32_t> &counter,
+                        std::atomic<uint32_t> &waiting, uint32_t value) {
+        counter.store(value);
+        if (waiting.load())
+            futex_wake(counter);
+    }
+
+   public:
+    // bytes of shared memory taken by a ring of messages of msg_bytes
+    static size_t footprint(size_t msg_bytes) {
+        return sizeof(header) + SLOTS * slot_size(msg_bytes);
+    }
+
+    shm_ring() : h(nullptr), slots(nullptr), msg_bytes(0), slot_bytes(0) {}
+
+    // over footprint(msg_bytes) bytes at p, set to zero
+    shm_ring(void *p, size_t msg_bytes)
+        : h(static_cast<header *>(p)),
+          slots(static_cast<char *>(p) + sizeof(header)),
+          msg_bytes(msg_bytes), slot_bytes(slot_size(msg_bytes)) {}
+
+    void send(const void *msg) {
+        const uint32_t head = h->head.load(std::memory_order_relaxed);
+        uint32_t tail;
+        while (head - (tail = h->tail.load(std::memory_order_acquire)) ==
+               SLOTS)
+            wait_change(h->tail, h->tail_waiting, tail);
+        std::memcpy(slots + (head % SLOTS) * slot_bytes, msg, msg_bytes);
+        publish(h->head, h->head_waiting, head + 1);
+    }
+
+    void recv(void *msg) {
+        const uint32_t tail = h->tail.load(std::memory_order_relaxed);
+        wait_change(h->head, h->head_waiting, tail);
+        std::memcpy(msg, slots + (tail % SLOTS) * slot_bytes, msg_bytes);
+        publish(h->tail, h->tail_waiting, tail + 1);
+    }
+};
+
+//
+// shared memory transport for bands forked from one process: two rings per
+// band, the rows it sends up and the rows it sends down. The segment is
+// created with shm_open and unlinked as soon as it is mapped, the children
+// inherit the mapping, so nothing is left behind if a process dies.
+//
+class shm_halo_transport : public halo_transport {
+   private:
+    int rank, n;
+    bool torus;
+    size_t row_bytes;
+    void *segment;
+    size_t segment_bytes;
+    shm_ring up_ring, down_ring; // written by this band
+    shm_ring from_up, from_down; // written by the neighbours
+
+    shm_ring ring(int band, int dir) const {
+        char *base = static_cast<char *>(segment);
+        return shm_ring(base + (2 * band + dir) *
+                                   shm_ring::footprint(row_bytes),
+                        row_bytes);
+    }
+
+   public:
+    // in the parent, before forking: the rings of n bands exchanging rows
+    // of row_bytes; with torus the first and last band are neighbours
+    shm_halo_transport(int n, size_t row_bytes, bool torus)
+        : rank(-1), n(n), torus(torus), row_bytes(row_bytes),
+          segment(MAP_FAILED),
+          segment_bytes(2 * n * shm_ring::footprint(row_bytes)) {
+        const std::string name = "/gol_halo." + std::to_string(getpid());
+        const int fd =
+            shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            std::cout << "shm_open " << name << " failed" << std::endl;
+            return;
+        }
+        if (ftruncate(fd, segment_bytes) == 0)
+            segment = mmap(nullptr, segment_bytes, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+        close(fd);
+        shm_unlink(name.c_str());
+        if (segment == MAP_FAILED)
+            std::cout << "Cannot map " << segment_bytes
+                      << " bytes of shared memory" << std::endl;
+    }
+
+    ~shm_halo_transport() {
+        if (segment != MAP_FAILED)
+            munmap(segment, segment_bytes);
+    }
+
+    shm_halo_transport(const shm_halo_transport &) = delete;
+    shm_halo_transport &operator=(const shm_halo_transport &) = delete;
+
+    bool ok() const { return segment != MAP_FAILED; }
+
+    // in the child owning band r
+    void attach(int r) {
+        rank = r;
+        up_ring = ring(r, 0);
+        down_ring = ring(r, 1);
+        // the band above sends its last row down, the one below its first
+        // row up
+        from_up = ring((r + n - 1) % n, 1);
+        from_down = ring((r + 1) % n, 0);
+    }
+
+    bool has_up() const { return torus || rank > 0; }
+    bool has_down() const { return torus || rank < n - 1; }
+
+    void send_up(const void *row) { up_ring.send(row); }
+    void send_down(const void *row) { down_ring.send(row); }
+    void recv_up(void *row) { from_up.recv(row); }
+    void recv_down(void *row) { from_down.recv(row); }
+    size_t bytes() const { return row_bytes; }
+};
+
+#endif
@@ -1,50 +1,209 @@
+#include <omp.h>
+
 #include <iostream>
 #include <thread>
 #include <vector>
 
+#include "../common/bitboard.hpp"
+#include "../common/checkpoint.hpp"
+#include "../common/colsum.hpp"
+#include "../common/grid.hpp"
+#include "../common/init.hpp"
+#include "../common/lut.hpp"
+#include "../common/options.hpp"
+#include "../common/render.hpp"
+#include "../common/rules.hpp"
+#include "../common/stats.hpp"
+
 using namespace std;
 
-int compute_future(int alive, int alive_neighbours) {
-    if (alive_neighbours < 2 || alive_neighbours > 3)
-        return 0;
-    else if (alive_neighbours == 3)
-        return 1;
-    else
-        return alive;
+// with torus the whole board is computed and the halo mirrors the
+// opposite edges, the edge rows are refreshed by the thread computing them;
+// with stats every thread counts and hashes the rows it computes in its
+// own slot; with colsum every thread rolls its column sums down each run
+// of consecutive rows it gets
+template <typename RULE>
+void update(const Grid<int> &board, Grid<int> &future, int nw, bool torus,
+            const RULE &rule, population *stats, bool colsum) {
+    const long b = torus ? 0 : 1, e = board.cols() - b;
+    #pragma omp parallel num_threads(nw)
+    {
+        pop_stats *mine =
+            stats != nullptr ? &stats->slot(omp_get_thread_num()) : nullptr;
+        column_sums<int> sums;
+        long centre = -2; // row of the sums
+        #pragma omp for schedule(runtime)
+        for (long i = b; i < board.rows() - b; ++i) {
+            const int *up = board[i - 1], *mid = board[i],
+                      *down = board[i + 1];
+            // out does not alias the rows read
+            int *__restrict out = future[i];
+            // the row, with count(j) the alive neighbours of cell j
+            auto row = [&](auto count) {
+                auto next = [&](long j) {
+                    return rule.next(mid[j], count(j));
+                };
+                if (mine != nullptr)
+                    mine->sweep_row(i, mid, out, b, e, next,
+                                    stats->hashing() ? board.cols() : 0);
+                else
+                    for (long j = b; j < e; ++j)
+                        out[j] = next(j);
+            };
+            if (colsum) {
+                const int *col = i == centre + 1 ? sums.next(board, i, b, e)
+                                                 : sums.first(board, i, b, e);
+                centre = i;
+                row([&](long j) { return colsum_neighbours(col, mid, j); });
+            } else {
+                row([&](long j) {
+                    return up[j - 1] + up[j] + up[j + 1] +
+                           mid[j - 1] + mid[j + 1] +
+                           down[j - 1] + down[j] + down[j + 1];
+                });
+            }
+            if (torus)
+                future.wrap_row(i);
+        }
+    }
 }
 
-void update(const vector<vector<int>> &board, vector<vector<int>> &future, int nw) {
-    #pragma omp parallel for num_threads(nw)
-    for (size_t i = 1; i < board.size() - 1; ++i) {
-        #pragma GCC ivdep
-        for (size_t j = 1; j < board[i].size() - 1; ++j) {
-            int alive_neighbours =
-                board[i - 1][j - 1] + board[i - 1][j] + board[i - 1][j + 1] +
-                board[i][j - 1] + board[i][j + 1] +
-                board[i + 1][j - 1] + board[i + 1][j] + board[i + 1][j + 1];
-            future[i][j] = compute_future(board[i][j], alive_neighbours);
-        }
+// B3/S23 only
+void update(const bitboard &board, bitboard &future, int nw, bool,
+            const life &, population *, bool) {
+    #pragma omp parallel for num_threads(nw) schedule(runtime)
+    for (size_t i = 1; i < board.rows() - 1; ++i)
+        board.step(future, i, i + 1);
+}
+
+// any rule; the kernel computes two rows at a time, so one pair per
+// iteration
+void update(const bitboard &board, bitboard &future, int nw, bool,
+            const lut_kernel &lut, population *, bool) {
+    const long last = board.rows() - 1;
+    #pragma omp parallel for num_threads(nw) schedule(runtime)
+    for (long i = 1; i < last; i += 2)
+        lut.step(board, future, i, min(i + 2, last));
+}
+
+template <typename BOARD, typename RULE>
+long simulate(BOARD &board, BOARD &future, unsigned long generations, int nw,
+              bool torus, checkpointer &ck, const RULE &rule,
+              population *stats = nullptr, bool colsum = false) {
+    renderer<BOARD> render(board, generations);
+    auto t0 = chrono::system_clock::now();
+    for (unsigned long it = 0; it < generations; ++it) {
+        update(board, future, nw, torus, rule, stats, colsum);
+        const bool stop = stats != nullptr && stats->end_generation();
+        swap(board, future);
+        ck.tick(board);
+        render.submit(board);
+        if (stop)
+            break;
     }
+    return chrono::duration_cast<chrono::milliseconds>(
+               chrono::system_clock::now() - t0)
+        .count();
 }
 
-void print(const vector<vector<int>> &board) {
-    string border(board[0].size() + 2, '-');
+//
+// one parallel region for the whole run: a single thread creates a task per
+// band of band_rows rows and generation, which reads the band and the two
+// next to it in the board of generation g and writes the band in the board
+// of generation g + 1. The boards alternate, and each task depends on the
+// tags of what it reads and writes, so a band starts as soon as its three
+// input bands are done and no thread waits for a whole generation; the
+// out dependence also keeps it from overwriting generation g - 1 before the
+// bands reading it are done. A last task per generation waits for all its
+// bands to hand the board to the checkpointer and the renderer; these last
+// tasks are chained in generation order, the checkpointer counts ticks.
+//
+template <typename RULE>
+long simulate_tasks(Grid<int> &board, Grid<int> &future,
+                    unsigned long generations, int nw, bool torus,
+                    checkpointer &ck, const RULE &rule, long band_rows) {
+    const long b = torus ? 0 : 1;
+    const long first = b, last = board.rows() - b;
+    const long bands = (last - first + band_rows - 1) / band_rows;
+    Grid<int> *cells[2] = {&board, &future};
+    // only their addresses matter, one per band of each board
+    vector<char> tags[2] = {vector<char>(bands), vector<char>(bands)};
+    char done; // tag of the last task of every generation
+    renderer<Grid<int>> render(board, generations);
 
-    cout << border << endl;
-    for (size_t i = 0; i < board.size(); ++i) {
-        cout << '|';
-        for (size_t j = 0; j < board[i].size(); ++j)
-            cout << (board[i][j] ? '*' : ' ');
-        cout << '|' << endl;
+    auto t0 = chrono::system_clock::now();
+    #pragma omp parallel num_threads(nw)
+    #pragma omp single
+    for (unsigned long it = 0; it < generations; ++it) {
+        char *in = tags[it % 2].data(), *out = tags[(it + 1) % 2].data();
+        const Grid<int> &from = *cells[it % 2];
+        Grid<int> &to = *cells[(it + 1) % 2];
+        for (long k = 0; k < bands; ++k) {
+            // on a torus the first and last band are next to each other
+            const long above = k > 0 ? k - 1 : torus ? bands - 1 : k;
+            const long below = k < bands - 1 ? k + 1 : torus ? 0 : k;
+            #pragma omp task default(shared) firstprivate(k, in, out) \
+                depend(in: in[above], in[k], in[below]) depend(out: out[k])
+            {
+                const long r1 = min(first + (k + 1) * band_rows, last);
+                for (long i = first + k * band_rows; i < r1; ++i) {
+                    const int *up = from[i - 1], *mid = from[i],
+                              *down = from[i + 1];
+                    int *__restrict row = to[i];
+                    for (long j = b; j < from.cols() - b; ++j) {
+                        int alive_neighbours =
+                            up[j - 1] + up[j] + up[j + 1] +
+                            mid[j - 1] + mid[j + 1] +
+                            down[j - 1] + down[j] + down[j + 1];
+                        row[j] = rule.next(mid[j], alive_neighbours);
+                    }
+                    if (torus)
+                        to.wrap_row(i);
+                }
+            }
+        }
+        #pragma omp task default(shared) firstprivate(out) \
+            depend(iterator(k = 0 : bands), in: out[k]) depend(inout: done)
+        {
+            ck.tick(to);
+            render.submit(to);
+        }
     }
-    cout << border << endl;
-    this_thread::sleep_for(chrono::milliseconds(50));
+    // the last generation is in future if odd
+    if (generations % 2 == 1)
+        swap(board, future);
+    return chrono::duration_cast<chrono::milliseconds>(
+               chrono::system_clock::now() - t0)
+        .count();
+}
+
+// --schedule=static|dynamic|guided[,chunk] for the loops over the rows
+bool set_schedule(const string &spec) {
+    const string kind = spec.substr(0, spec.find(','));
+    const int chunk =
+        spec.find(',') == string::npos ? 0 : atoi(&spec[spec.find(',') + 1]);
+    if (kind == "static")
+        omp_set_schedule(omp_sched_static, chunk);
+    else if (kind == "dynamic")
+        omp_set_schedule(omp_sched_dynamic, chunk);
+    else if (kind == "guided")
+        omp_set_schedule(omp_sched_guided, chunk);
+    else
+        return false;
+    return true;
 }
 
 int main(int argc, char const *argv[]) {
     if (argc < 6) {
         cout << "Usage is " << argv[0]
-             << " rows cols generations seed nw" << endl;
+             << " rows cols generations seed nw"
+             << " [--engine=int|bits|lut|tasks] [--torus]"
+             << " [--rule=B3/S23] [--kernel=direct|colsum]"
+             << " [--schedule=static|dynamic|guided[,chunk]] [--tile-rows=16]"
+             << " [--load=pattern] [--save=pattern] [--density=0.5]" << endl
+             << "[--checkpoint=file --checkpoint-every=1000 --compress]"
+             << " [--resume=file] [--stats] [--cycle=8 [--extrapolate]]"
+             << endl << "[--record=file --keyframe-every=64]" << endl;
         return -1;
     }
 
@@ -53,28 +212,122 @@ int main(int argc, char const *argv[]) {
     const unsigned long generations = atol(argv[3]);
     const int seed = atoi(argv[4]);
     const int nw = atoi(argv[5]);
+    const options opts(argc, argv, 6);
+    const string engine = opts.get("engine", "int");
+    const bool torus = opts.has("torus");
+    const string load = opts.get("load", "");
+    const string save = opts.get("save", "");
+    const double density = atof(opts.get("density", "0.5").c_str());
+    if (engine != "int" && engine != "bits" && engine != "lut" &&
+        engine != "tasks") {
+        cout << "Invalid engine " << engine << ", expected int|bits|lut|tasks"
+             << endl;
+        return -1;
+    }
+    checkpointer ck(opts, seed);
+    rule_spec rule;
+    if (!parse_rule(opts.get("rule", "B3/S23"), rule)) {
+        cout << "Invalid rule " << opts.get("rule", "") << endl;
+        return -1;
+    }
+    bool colsum;
+    if (!parse_kernel(opts.get("kernel", "direct"), colsum)) {
+        cout << "Invalid kernel " << opts.get("kernel", "") << endl;
+        return -1;
+    }
 
-    // boards allocation
-    vector<vector<int>> board(rows, vector(cols, 0));
-    vector<vector<int>> future(rows, vector(cols, 0));
+    if (!set_schedule(opts.get("schedule", "static"))) {
+        cout << "Invalid schedule " << opts.get("schedule", "") << endl;
+        return -1;
+    }
+    const long band_rows = opts.get("tile-rows", 16L);
+    if (band_rows < 1) {
+        cout << "--tile-rows must be positive" << endl;
+        return -1;
+    }
 
-    // board initialization
-    srand(seed);
-    for (size_t i = 1; i < board.size() - 1; ++i)
-        for (size_t j = 1; j < board[i].size() - 1; ++j)
-            board[i][j] = rand() % 2;
-    
-    auto t0 = chrono::system_clock::now();
-    for (unsigned long it = 0; it < generations; ++it) {
-        update(board, future, nw);
-        board.swap(future);
+    long elapsed;
+    if (torus && engine != "int" && engine != "tasks") {
+        cout << "--torus is supported by the int and tasks engines only"
+             << endl;
+        return -1;
+    }
+    if (rule != life::spec && engine == "bits") {
+        cout << "--rule is supported by the int, lut and tasks engines only"
+             << endl;
+        return -1;
+    }
+    // live cells, births, deaths and bounding box of every generation,
+    // and/or a stop at the first cycle of period up to --cycle
+    population stats(nw, opts.has("stats"),
+                     cycle_detector(opts.get("cycle", 0L),
+                                    ck.remaining(generations),
+                                    opts.has("extrapolate")));
+    population *tracked = stats.enabled() ? &stats : nullptr;
+    if (colsum && engine != "int") {
+        cout << "--kernel is supported by the int engine only" << endl;
+        return -1;
+    }
+    if (tracked != nullptr && engine != "int") {
+        cout << "--stats and --cycle are supported by the int engine only"
+             << endl;
+        return -1;
+    }
+    if (engine == "bits" || engine == "lut") {
+        // 64 cells per word
+        bitboard board(rows, cols), future(rows, cols);
+
+        if (!(ck.resuming() ? ck.restore(board)
+                            : init_board(board, load, seed, nw, density)))
+            return -1;
+        ck.start(board);
+
+        if (engine == "lut") {
+            if (rule != life::spec)
+                cout << "Running " << rule.name() << endl;
+            const lut_kernel lut(rule, board.words());
+            elapsed = simulate(board, future, ck.remaining(generations), nw,
+                               torus, ck, lut);
+        } else {
+            elapsed = simulate(board, future, ck.remaining(generations), nw,
+                               torus, ck, life{});
+        }
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    } else {
+        // boards allocation
+        Grid<int> board(rows, cols, 1), future(rows, cols, 1);
+
+        // checkpoint, pattern or random cells, on a torus there is no dead
+        // border
+        if (!(ck.resuming() ? ck.restore(board, torus)
+                            : init_board(board, load, seed, torus, nw,
+                                         density)))
+            return -1;
+        ck.start(board);
+
+        if (colsum && !colsum_self_check<int>()) {
+            cout << "Column sums disagree with the direct count" << endl;
+            return -1;
+        }
+        if (rule != life::spec)
+            cout << "Running " << rule.name() << endl;
+        elapsed = with_rule(rule, [&](const auto &rule) {
+            if (engine == "tasks")
+                return simulate_tasks(board, future,
+                                      ck.remaining(generations), nw, torus,
+                                      ck, rule, band_rows);
+            return simulate(board, future, ck.remaining(generations), nw,
+                            torus, ck, rule, tracked, colsum);
+        });
 
-        cout << it + 1 << "/" << generations << endl;
-        print(board);
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
     }
-    auto elapsed = chrono::duration_cast<chrono::milliseconds>(
-                       chrono::system_clock::now() - t0)
-                       .count();
-    cout << "Parallel execution with " << nw << " workers took " << elapsed << " msecs" << endl;
+    cout << "Parallel execution (" << engine << ") with " << nw
+         << " workers took " << elapsed << " msecs" << endl;
     return 0;
 }
@@ -4,7 +4,7 @@ class Source {
    public:
     virtual OUT next() = 0;
     virtual bool hasNext() = 0;
-    virtual void feedback_notify();
+    virtual void feedback_notify() {}
 };
 
 // business logic to compute a task
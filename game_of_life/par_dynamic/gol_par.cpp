@@ -1,45 +1,26 @@
 #include <assert.h>
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <mutex>
 #include <queue>
+#include <random>
 #include <thread>
 
+#include "../common/barrier.hpp"
+#include "../common/init.hpp"
+#include "../common/options.hpp"
+#include "../common/ws_deque.hpp"
 #include "BLcode.cpp"
 #include "queue.cpp"
 
 using namespace std;
 
-int main(int argc, char* argv[]) {
-    if (argc < 7) {
-        cout << "Usage is " << argv[0]
-             << " rows cols generations chunk_size seed nw" << endl;
-        return -1;
-    }
-
-    const size_t rows = atol(argv[1]);
-    const size_t cols = atol(argv[2]);
-    const unsigned long generations = atol(argv[3]);
-    const int chunk_size = atoi(argv[4]);
-    const int seed = atoi(argv[5]);
-    const int nw = atoi(argv[6]);
-
-    // boards allocation
-    vector<vector<int>> board(rows, vector(cols, 0));
-    vector<vector<int>> future(rows, vector(cols, 0));
-
-    // board initialization
-    srand(seed);
-    for (size_t i = 1; i < board.size() - 1; ++i)
-        for (size_t j = 1; j < board[i].size() - 1; ++j)
-            board[i][j] = rand() % 2;
-
-    // business logic code components
-    MySource s{board, 0, nw, chunk_size};
-    MyWorker f{board, future, 0};
-    MyDrain d{board, future, 0};
-
+// with stats the emitter stops at the generation the drain finds a cycle
+template <typename SOURCE, typename WORKER, typename DRAIN>
+long farm(SOURCE s, WORKER f, DRAIN d, unsigned long generations, int nw,
+          const population *stats = nullptr) {
     // implementing flow control
     const pair<int, int> EOS{-1, -1};
     const int GOON = 1;
@@ -53,7 +34,7 @@ int main(int argc, char* argv[]) {
 
     // kind of three concurrent activities
     // place input tasks into the input queue
-    auto emit_task = [&](MySource s) {
+    auto emit_task = [&](SOURCE s) {
         for (unsigned long i = 0; i < generations; ++i) {
             while (s.hasNext()) {
                 auto t = s.next();
@@ -64,6 +45,8 @@ int main(int argc, char* argv[]) {
                 s.feedback_notify();
             else
                 cout << "Impossible case" << endl;
+            if (stats != nullptr && stats->stopped())
+                break;
         }
         // for as many workers to terminate, push EOS
         for (int i = 0; i < nw; i++)
@@ -72,7 +55,7 @@ int main(int argc, char* argv[]) {
     };
 
     // process results
-    auto proc_res = [&](MyDrain d, int nw) {
+    auto proc_res = [&](DRAIN d, int nw) {
         while (true) {
             auto t = r_queue.pop();
             if (t == EOS.first && (--nw) == 0)
@@ -83,7 +66,7 @@ int main(int argc, char* argv[]) {
     };
 
     // processing tasks to results in parallel
-    auto body = [&](MyWorker w, int wn) {
+    auto body = [&](WORKER w, int wn) {
         while (true) {
             auto t = t_queue.pop();
             if (t == EOS) {
@@ -112,9 +95,415 @@ int main(int argc, char* argv[]) {
     auto elapsed = chrono::duration_cast<chrono::milliseconds>(
                        chrono::system_clock::now() - t0)
                        .count();
+    return elapsed;
+}
+
+// farm over chunks of chunk_size rows
+template <typename BOARD, typename WORKER>
+long farm(BOARD &board, BOARD &future, WORKER f, unsigned long generations,
+          int chunk_size, int nw, checkpointer &ck, bool torus = false,
+          population *stats = nullptr) {
+    renderer<BOARD> render(board);
+    return farm(MySource{board, 0, nw, chunk_size, torus}, f,
+                MyDrain{board, future, 0, ck, render, torus, stats},
+                generations, nw, stats);
+}
+
+// resident workers, no queues: each generation the workers claim chunks of
+// chunk_size rows from a shared index and meet at a barrier, where the last
+// one to arrive ends the generation as the drain does
+template <typename BOARD, typename WORKER>
+long resident(BOARD &board, BOARD &future, WORKER f,
+              unsigned long generations, int chunk_size, int nw,
+              checkpointer &ck, thread_barrier &barrier, bool torus = false,
+              population *stats = nullptr) {
+    const long first = torus ? 0 : 1;
+    const long last = torus ? board.size() : board.size() - 1;
+    const long chunks = (last - first + chunk_size - 1) / chunk_size;
+
+    atomic<long> next{0};
+    renderer<BOARD> render(board);
+
+    auto body = [&](WORKER w, int wn) {
+        for (unsigned long i = 0; i < generations; ++i) {
+            long c;
+            while ((c = next.fetch_add(1, memory_order_relaxed)) < chunks) {
+                const long row = first + c * chunk_size;
+                w.compute({row, min<long>(chunk_size, last - row)});
+            }
+            barrier.wait(wn, [&] {
+                next.store(0, memory_order_relaxed);
+                if (stats != nullptr)
+                    stats->end_generation();
+                swap(board, future);
+                ck.tick(board);
+                render.submit(board);
+            });
+            if (stats != nullptr && stats->stopped())
+                break;
+        }
+    };
+
+    auto t0 = chrono::system_clock::now();
+    vector<thread> tids;
+    for (int i = 0; i < nw; i++)
+        tids.emplace_back(body, f, i);
+    for (auto &t : tids)
+        t.join();
+    return chrono::duration_cast<chrono::milliseconds>(
+               chrono::system_clock::now() - t0)
+        .count();
+}
+
+// work stealing: each generation every worker is seeded with a contiguous
+// block of chunks, for locality, and runs them from its own deque; once
+// out of work it steals half of the chunks left to a random victim. The
+// generation ends at a barrier when no chunk is left
+template <typename BOARD, typename WORKER>
+long stealing(BOARD &board, BOARD &future, WORKER f,
+              unsigned long generations, int chunk_size, int nw,
+              checkpointer &ck, thread_barrier &barrier, bool torus = false,
+              population *stats = nullptr) {
+    const long first = torus ? 0 : 1;
+    const long last = torus ? board.size() : board.size() - 1;
+    const long chunks = (last - first + chunk_size - 1) / chunk_size;
+
+    vector<unique_ptr<ws_deque>> deques;
+    for (int i = 0; i < nw; i++)
+        deques.emplace_back(new ws_deque((chunks + nw - 1) / nw));
+    struct alignas(64) counter {
+        long steals = 0;
+    };
+    vector<counter> steals(nw);
+    atomic<long> left{chunks}; // chunks not computed yet
+    renderer<BOARD> render(board);
+    unsigned long generation = 0;
+
+    auto body = [&](WORKER w, int wn) {
+        ws_deque &own = *deques[wn];
+        minstd_rand rng(wn + 1);
+        auto run = [&](long c) {
+            const long row = first + c * chunk_size;
+            w.compute({row, min<long>(chunk_size, last - row)});
+            left.fetch_sub(1, memory_order_relaxed);
+        };
+
+        for (unsigned long i = 0; i < generations; ++i) {
+            // own block, first chunk at the bottom
+            for (long c = (wn + 1) * chunks / nw - 1; c >= wn * chunks / nw;
+                 --c)
+                own.push(c);
+
+            while (left.load(memory_order_relaxed) > 0) {
+                long c;
+                while ((c = own.pop()) >= 0)
+                    run(c);
+                if (nw == 1)
+                    continue;
+
+                ws_deque &victim = *deques[(wn + 1 + rng() % (nw - 1)) % nw];
+                long n = (victim.size() + 1) / 2, got = 0;
+                while (n-- > 0) {
+                    c = victim.steal();
+                    if (c == ws_deque::EMPTY)
+                        break;
+                    if (c == ws_deque::ABORT)
+                        continue;
+                    if (got++ == 0)
+                        run(c);
+                    else
+                        own.push(c);
+                }
+                steals[wn].steals += got;
+            }
+
+            barrier.wait(wn, [&] {
+                long total = 0;
+                for (auto &s : steals) {
+                    total += s.steals;
+                    s.steals = 0;
+                }
+                cout << "Generation " << ++generation << ": " << total
+                     << " chunks stolen" << endl;
+                left.store(chunks, memory_order_relaxed);
+                if (stats != nullptr)
+                    stats->end_generation();
+                swap(board, future);
+                ck.tick(board);
+                render.submit(board);
+            });
+            if (stats != nullptr && stats->stopped())
+                break;
+        }
+    };
+
+    auto t0 = chrono::system_clock::now();
+    vector<thread> tids;
+    for (int i = 0; i < nw; i++)
+        tids.emplace_back(body, f, i);
+    for (auto &t : tids)
+        t.join();
+    return chrono::duration_cast<chrono::milliseconds>(
+               chrono::system_clock::now() - t0)
+        .count();
+}
+
+// the farm, the resident workers or work stealing, by --driver; the last
+// two meet at barrier at the end of every generation
+template <typename BOARD, typename WORKER>
+long run(const string &driver, thread_barrier &barrier, BOARD &board,
+         BOARD &future, WORKER f, unsigned long generations, int chunk_size,
+         int nw, checkpointer &ck, bool torus = false,
+         population *stats = nullptr) {
+    if (driver == "resident")
+        return resident(board, future, f, generations, chunk_size, nw, ck,
+                        barrier, torus, stats);
+    if (driver == "steal")
+        return stealing(board, future, f, generations, chunk_size, nw, ck,
+                        barrier, torus, stats);
+    return farm(board, future, f, generations, chunk_size, nw, ck, torus,
+                stats);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 7) {
+        cout << "Usage is " << argv[0]
+             << " rows cols generations chunk_size seed nw"
+             << " [--engine=int|bits|simd|tiled|active|ltl] [--torus]"
+             << " [--rule=B3/S23] [--kernel=direct|colsum]"
+             << " [--k=4 --tile-rows=64 --tile-cols=256]"
+             << " [--load=pattern] [--save=pattern] [--density=0.5]" << endl
+             << "[--checkpoint=file --checkpoint-every=1000 --compress]"
+             << " [--resume=file] [--driver=farm|resident|steal] [--stats]"
+             << " [--cycle=8 [--extrapolate]]" << endl
+             << "[--barrier=central|tree|dissemination"
+             << " --barrier-spins=1024 --barrier-wait=futex|yield]"
+             << " [--record=file --keyframe-every=64]" << endl
+             << "with --engine=active chunk_size is in tiles" << endl
+             << "with --engine=ltl the rule is Larger-than-Life, " << BOSCO
+             << " by default" << endl;
+        return -1;
+    }
+
+    const size_t rows = atol(argv[1]);
+    const size_t cols = atol(argv[2]);
+    const unsigned long generations = atol(argv[3]);
+    const int chunk_size = atoi(argv[4]);
+    const int seed = atoi(argv[5]);
+    const int nw = atoi(argv[6]);
+    const options opts(argc, argv, 7);
+    const string engine = opts.get("engine", "int");
+    const bool torus = opts.has("torus");
+    const string driver = opts.get("driver", "farm");
+    const string load = opts.get("load", "");
+    const string save = opts.get("save", "");
+    const double density = atof(opts.get("density", "0.5").c_str());
+    if (engine != "int" && engine != "bits" && engine != "simd" &&
+        engine != "tiled" && engine != "active" && engine != "ltl") {
+        cout << "Invalid engine " << engine << ", expected "
+             << "int|bits|simd|tiled|active|ltl" << endl;
+        return -1;
+    }
+    if (driver != "farm" && driver != "resident" && driver != "steal") {
+        cout << "Invalid driver " << driver << ", expected farm|resident|steal"
+             << endl;
+        return -1;
+    }
+    checkpointer ck(opts, seed);
+    // Larger-than-Life rules for the ltl engine, B/S rules for the others
+    rule_spec rule = life::spec;
+    ltl_rule ltl;
+    if (engine == "ltl" ? !parse_ltl(opts.get("rule", BOSCO), ltl)
+                        : !parse_rule(opts.get("rule", "B3/S23"), rule)) {
+        cout << "Invalid rule " << opts.get("rule", "") << endl;
+        return -1;
+    }
+    bool colsum;
+    if (!parse_kernel(opts.get("kernel", "direct"), colsum)) {
+        cout << "Invalid kernel " << opts.get("kernel", "") << endl;
+        return -1;
+    }
+
+    if (torus && engine != "int" && engine != "simd") {
+        cout << "--torus is supported by the int and simd engines only"
+             << endl;
+        return -1;
+    }
+    if (rule != life::spec && engine != "int") {
+        cout << "--rule is supported by the int engine only" << endl;
+        return -1;
+    }
+    // live cells, births, deaths and bounding box of every generation,
+    // and/or a stop at the first cycle of period up to --cycle
+    population stats(nw, opts.has("stats"),
+                     cycle_detector(opts.get("cycle", 0L),
+                                    ck.remaining(generations),
+                                    opts.has("extrapolate")));
+    population *tracked = stats.enabled() ? &stats : nullptr;
+    if (colsum && engine != "int") {
+        cout << "--kernel is supported by the int engine only" << endl;
+        return -1;
+    }
+    if (tracked != nullptr && engine != "int") {
+        cout << "--stats and --cycle are supported by the int engine only"
+             << endl;
+        return -1;
+    }
+    // temporal blocking of the tiled engine, tiles of the active one
+    const long k = opts.get("k", 4L);
+    const long tile_rows = opts.get("tile-rows", 64L);
+    const long tile_cols = opts.get("tile-cols", 256L);
+    if (engine == "tiled" && (k < 1 || tile_rows < 1 || tile_cols < 1)) {
+        cout << "--k, --tile-rows and --tile-cols must be positive" << endl;
+        return -1;
+    }
+    if (engine == "active" && (tile_rows < 1 || tile_cols < 1)) {
+        cout << "--tile-rows and --tile-cols must be positive" << endl;
+        return -1;
+    }
+    if (driver != "farm" && engine == "active") {
+        cout << "The active engine runs on the farm driver only" << endl;
+        return -1;
+    }
+    // where the resident and stealing workers meet every generation
+    wait_policy policy;
+    policy.spins = opts.get("barrier-spins", 1024L);
+    policy.futex = opts.get("barrier-wait", "futex") == "futex";
+    auto barrier = make_barrier(opts.get("barrier", "central"), nw, policy);
+    if (!barrier) {
+        cout << "Invalid barrier " << opts.get("barrier", "") << endl;
+        return -1;
+    }
+
+    long elapsed;
+    if (engine == "bits") {
+        // 64 cells per word
+        bitboard board(rows, cols), future(rows, cols);
+
+        if (!(ck.resuming() ? ck.restore(board)
+                            : init_board(board, load, seed, nw, density)))
+            return -1;
+        ck.start(board);
+
+        elapsed = run(driver, *barrier, board, future,
+                      MyBitWorker{board, future, 0},
+                      ck.remaining(generations), chunk_size, nw, ck);
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    } else if (engine == "simd" || engine == "tiled" || engine == "active") {
+        if (!row_kernels_self_check()) {
+            cout << "SIMD kernels disagree with the scalar path" << endl;
+            return -1;
+        }
+        cout << "Using the " << select_row_kernel().name << " row kernel"
+             << endl;
+
+        Grid<uint8_t> board(rows, cols, 1), future(rows, cols, 1);
+
+        // checkpoint, pattern or random cells, on a torus there is no dead
+        // border
+        if (!(ck.resuming() ? ck.restore(board, torus)
+                            : init_board(board, load, seed, torus, nw,
+                                         density)))
+            return -1;
+        ck.start(board);
+
+        if (engine == "tiled") {
+            cout << "Advancing " << tile_rows << "x" << tile_cols
+                 << " tiles by " << k << " generations" << endl;
+
+            const unsigned long remaining = ck.remaining(generations);
+            ck.set_stride(k);
+            elapsed = run(driver, *barrier, board, future,
+                          MyTiledWorker{board, future, 0, k,
+                                        tile_rows, tile_cols},
+                          remaining / k, chunk_size, nw, ck);
+            if (remaining % k != 0) {
+                ck.set_stride(remaining % k);
+                elapsed += run(driver, *barrier, board, future,
+                               MyTiledWorker{board, future, 0,
+                                             long(remaining % k),
+                                             tile_rows, tile_cols},
+                               1, chunk_size, nw, ck);
+            }
+        } else if (engine == "active") {
+            // recompute only the tiles around the changes
+            tile_activity activity(rows, cols, tile_rows, tile_cols);
+            renderer<Grid<uint8_t>> render(board);
+
+            elapsed = farm(MyActiveSource{activity, chunk_size},
+                           MyActiveWorker{board, future, activity},
+                           MyActiveDrain{board, future, activity, ck, render},
+                           ck.remaining(generations), nw);
+        } else {
+            elapsed = run(driver, *barrier, board, future,
+                          MySimdWorker{board, future, 0, torus},
+                          ck.remaining(generations), chunk_size, nw, ck,
+                          torus);
+        }
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    } else if (engine == "ltl") {
+        Grid<int> board(rows, cols, 1), future(rows, cols, 1);
+
+        if (!(ck.resuming() ? ck.restore(board)
+                            : init_board(board, load, seed, false, nw,
+                                         density)))
+            return -1;
+        ck.start(board);
+
+        if (!ltl_self_check(ltl)) {
+            cout << "Summed-area counts disagree with the direct count"
+                 << endl;
+            return -1;
+        }
+        cout << "Running " << ltl.name() << endl;
+        summed_area sat(rows, cols, ltl.r, 1, rows - 1);
+        sat.build(board, nw);
+        elapsed = run(driver, *barrier, board, future,
+                      MyLtlWorker{board, future, 0, ltl, sat},
+                      ck.remaining(generations), chunk_size, nw, ck);
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, ltl))
+            return -1;
+    } else {
+        // boards allocation
+        Grid<int> board(rows, cols, 1), future(rows, cols, 1);
+
+        // checkpoint, pattern or random cells, on a torus there is no dead
+        // border
+        if (!(ck.resuming() ? ck.restore(board, torus)
+                            : init_board(board, load, seed, torus, nw,
+                                         density)))
+            return -1;
+        ck.start(board);
+
+        if (colsum && !colsum_self_check<int>()) {
+            cout << "Column sums disagree with the direct count" << endl;
+            return -1;
+        }
+        if (rule != life::spec)
+            cout << "Running " << rule.name() << endl;
+        elapsed = with_rule(rule, [&](const auto &rule) {
+            return run(driver, *barrier, board, future,
+                       MyWorker{board, future, 0, rule, torus, tracked,
+                                colsum},
+                       ck.remaining(generations), chunk_size, nw, ck, torus,
+                       tracked);
+        });
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    }
 
-    cout << "Parallel execution with " << nw << " threads took " << elapsed
-         << " msecs" << endl;
+    cout << "Parallel execution (" << engine << ", " << driver << ") with "
+         << nw << " threads took " << elapsed << " msecs" << endl;
         // << "speedup is " << ((float)tseq) / ((float)elapsed) << endl;
     return 0;
 }
@@ -3,98 +3,258 @@
 #include <iostream>
 #include <thread>
 
+#include "../common/bitboard.hpp"
+#include "../common/checkpoint.hpp"
+#include "../common/colsum.hpp"
+#include "../common/grid.hpp"
+#include "../common/ltl.hpp"
+#include "../common/lut.hpp"
+#include "../common/render.hpp"
+#include "../common/rules.hpp"
+#include "../common/simd.hpp"
+#include "../common/stats.hpp"
+#include "../common/tiled.hpp"
 #include "BLcode.hpp"
 
 using namespace std;
 
-void print(const vector<vector<int>> &board) {
-    string border(board[0].size() + 2, '-');
-
-    cout << border << endl;
-    for (size_t i = 0; i < board.size(); ++i) {
-        cout << '|';
-        for (size_t j = 0; j < board[i].size(); ++j)
-            cout << (board[i][j] ? '*' : ' ');
-        cout << '|' << endl;
-    }
-    cout << border << endl;
-    this_thread::sleep_for(chrono::milliseconds(50));
-}
-
-// tasks to be computed: stream of rows, provided as iterator
+// tasks to be computed: stream of rows, provided as iterator; the rows are
+// cut in nw chunks, the last one taking the remainder, chunk w for worker
+// w every generation (the rows numa_layout::owned_rows() gives it)
+template <typename BOARD>
 class MySource : public Source<pair<int, int>> {
    private:
-    vector<vector<int>> &board;
-    int msec, chunk_size;
-    size_t row;
+    BOARD &board;
+    int msec, nw, chunk_size;
+    size_t first, last; // rows to compute: all of them on a torus
+    int w;              // next chunk
 
    public:
-    MySource(vector<vector<int>> &board, int ms, int nw) : board(board), msec(ms), row(1) {
-        chunk_size = (board.size() - 2) / nw;
+    MySource(BOARD &board, int ms, int nw, bool torus = false)
+        : board(board), msec(ms), nw(nw), first(torus ? 0 : 1),
+          last(torus ? board.size() : board.size() - 1), w(0) {
+        chunk_size = (last - first) / nw;
     }
 
     pair<int, int> next() {
-        pair<int, int> next{row, chunk_size};
-        row += chunk_size;
+        const size_t row = first + size_t(w) * chunk_size;
+        pair<int, int> next{row, w == nw - 1 ? last - row : chunk_size};
+        ++w;
         return next;
     }
 
     bool hasNext() {
-        return row < board.size() - 1;
+        return w < nw;
     }
 
     void feedback_notify() {
-        row = 1; // start from the beginning
+        w = 0; // start from the beginning
     }
 };
 
 // business logic to compute a task
+template <typename RULE>
 class MyWorker : public Worker<pair<int, int>, int> {
    private:
-    const vector<vector<int>> &board;
-    vector<vector<int>> &future;
+    const Grid<int> &board;
+    Grid<int> &future;
     int msec;
+    RULE rule;
+    bool torus;
+    population *stats;
+    pop_stats *mine; // claimed by the copy of the worker thread
+    bool colsum;
+    column_sums<int> sums; // of the copy of the worker thread
+
+   public:
+    // on a torus the whole row is computed and the worker owning a row
+    // refreshes the halo cells mirroring it; with stats the statistics of
+    // the new cells are counted, and the cells that changed hashed, in the
+    // same sweep. With colsum the neighbours are counted from column sums
+    // rolled down the chunk
+    MyWorker(const Grid<int> &board, Grid<int> &future, int ms, RULE rule,
+             bool torus = false, population *stats = nullptr,
+             bool colsum = false)
+        : board(board), future(future), msec(ms), rule(rule), torus(torus),
+          stats(stats), mine(nullptr), colsum(colsum) {}
 
-    int compute_future(int alive, int alive_neighbours) {
-        if (alive_neighbours < 2 || alive_neighbours > 3)
-            return 0;
-        else if (alive_neighbours == 3)
-            return 1;
-        else
-            return alive;
+    int compute(pair<int, int> pair) {
+        const int start{pair.first}, chunk_size{pair.second};
+        if (stats != nullptr && mine == nullptr)
+            mine = &stats->claim();
+        for (int i = start; i < start + chunk_size; ++i) {
+            const int *up = board[i - 1], *mid = board[i], *down = board[i + 1];
+            int *__restrict out = future[i];
+            const long b = torus ? 0 : 1, e = board.cols() - b;
+            // the row, with count(j) the alive neighbours of cell j
+            auto row = [&](auto count) {
+                auto next = [&](long j) {
+                    return rule.next(mid[j], count(j));
+                };
+                if (mine != nullptr)
+                    mine->sweep_row(i, mid, out, b, e, next,
+                                    stats->hashing() ? board.cols() : 0);
+                else
+                    for (long j = b; j < e; ++j)
+                        out[j] = next(j);
+            };
+            if (colsum) {
+                const int *col = i == start ? sums.first(board, i, b, e)
+                                            : sums.next(board, i, b, e);
+                row([&](long j) { return colsum_neighbours(col, mid, j); });
+            } else {
+                row([&](long j) {
+                    return up[j - 1] + up[j] + up[j + 1] +
+                           mid[j - 1] + mid[j + 1] +
+                           down[j - 1] + down[j] + down[j + 1];
+                });
+            }
+            if (torus)
+                future.wrap_row(i);
+        }
+        return chunk_size; // number of rows computed
     }
+};
+
+// business logic to compute a task of a Larger-than-Life rule, each cell
+// from 4 entries of the summed-area table of the board; the rows computed
+// are then summed into the table of the next generation
+class MyLtlWorker : public Worker<pair<int, int>, int> {
+   private:
+    const Grid<int> &board;
+    Grid<int> &future;
+    int msec;
+    ltl_rule rule;
+    summed_area &sat;
+    vector<uint32_t> scratch; // of the copy of the worker thread
 
    public:
-    MyWorker(const vector<vector<int>> &board, vector<vector<int>> &future, int ms)
+    MyLtlWorker(const Grid<int> &board, Grid<int> &future, int ms,
+                const ltl_rule &rule, summed_area &sat)
+        : board(board), future(future), msec(ms), rule(rule), sat(sat) {}
+
+    int compute(pair<int, int> pair) {
+        const int start{pair.first}, chunk_size{pair.second};
+        sat.advance(rule, board, future, start, start + chunk_size, scratch);
+        return chunk_size; // number of rows computed
+    }
+};
+
+// business logic to compute a task on the bit-packed boards
+class MyBitWorker : public Worker<pair<int, int>, int> {
+   private:
+    const bitboard &board;
+    bitboard &future;
+    int msec;
+
+   public:
+    MyBitWorker(const bitboard &board, bitboard &future, int ms)
         : board(board), future(future), msec(ms) {}
 
     int compute(pair<int, int> pair) {
         const int start{pair.first}, chunk_size{pair.second};
+        board.step(future, start, start + chunk_size);
+        return chunk_size; // number of rows computed
+    }
+};
+
+// business logic to compute a task on the bit-packed boards, 2x2 blocks at
+// a time through the table of the rule
+class MyLutWorker : public Worker<pair<int, int>, int> {
+   private:
+    const bitboard &board;
+    bitboard &future;
+    int msec;
+    const lut_kernel &lut;
+
+   public:
+    MyLutWorker(const bitboard &board, bitboard &future, int ms,
+                const lut_kernel &lut)
+        : board(board), future(future), msec(ms), lut(lut) {}
+
+    int compute(pair<int, int> pair) {
+        const int start{pair.first}, chunk_size{pair.second};
+        lut.step(board, future, start, start + chunk_size);
+        return chunk_size; // number of rows computed
+    }
+};
+
+// business logic to compute a task on uint8 cells with the SIMD row kernel
+// selected at startup
+class MySimdWorker : public Worker<pair<int, int>, int> {
+   private:
+    const Grid<uint8_t> &board;
+    Grid<uint8_t> &future;
+    int msec;
+    row_kernel_t kernel;
+    bool torus;
+
+   public:
+    MySimdWorker(const Grid<uint8_t> &board, Grid<uint8_t> &future, int ms,
+                 bool torus = false)
+        : board(board), future(future), msec(ms),
+          kernel(select_row_kernel().fn), torus(torus) {}
+
+    int compute(pair<int, int> pair) {
+        const int start{pair.first}, chunk_size{pair.second};
+        const long b = torus ? 0 : 1;
+        const size_t n = board.cols() - 2 * b;
         for (int i = start; i < start + chunk_size; ++i) {
-            #pragma GCC ivdep
-            for (size_t j = 1; j < board[i].size() - 1; ++j) {
-                int alive_neighbours =
-                    board[i - 1][j - 1] + board[i - 1][j] + board[i - 1][j + 1] +
-                    board[i][j - 1] + board[i][j + 1] +
-                    board[i + 1][j - 1] + board[i + 1][j] + board[i + 1][j + 1];
-                future[i][j] = compute_future(board[i][j], alive_neighbours);
-            }
+            kernel(&board[i - 1][b], &board[i][b], &board[i + 1][b],
+                   &future[i][b], n);
+            if (torus)
+                future.wrap_row(i);
         }
         return chunk_size; // number of rows computed
     }
 };
 
+// business logic to compute a task with temporal blocking: the row chunk is
+// cut in tiles, each one advanced by k generations while it is in cache
+class MyTiledWorker : public Worker<pair<int, int>, int> {
+   private:
+    const Grid<uint8_t> &board;
+    Grid<uint8_t> &future;
+    int msec;
+    tile_stepper tiles;
+
+   public:
+    MyTiledWorker(const Grid<uint8_t> &board, Grid<uint8_t> &future, int ms,
+                  long k, long tile_rows, long tile_cols)
+        : board(board), future(future), msec(ms),
+          tiles(k, tile_rows, tile_cols) {}
+
+    int compute(pair<int, int> pair) {
+        const long start{pair.first}, end{pair.first + pair.second};
+        const long last_col = board.cols() - 1;
+        for (long r = start; r < end; r += tiles.rows())
+            for (long c = 1; c < last_col; c += tiles.cols())
+                tiles.advance(board, future, r, min(r + tiles.rows(), end),
+                              c, min(c + tiles.cols(), last_col));
+        return pair.second; // number of rows computed
+    }
+};
+
 // processing the results: accumulate the stream contents
+template <typename BOARD>
 class MyDrain : public Drain<int, bool> {
    private:
-    vector<vector<int>> &board, &future;
+    BOARD &board, &future;
+    checkpointer &ck;
+    renderer<BOARD> &render;
+    population *stats;
     int msec;
+    int rows; // computed each generation
     int remaining;
 
    public:
-    MyDrain(vector<vector<int>> &board, vector<vector<int>> &future, int ms)
-        : board(board), future(future), msec(ms) {
-        remaining = board.size() - 2;
+    MyDrain(BOARD &board, BOARD &future, int ms, checkpointer &ck,
+            renderer<BOARD> &render, bool torus = false,
+            population *stats = nullptr)
+        : board(board), future(future), ck(ck), render(render), stats(stats),
+          msec(ms) {
+        rows = torus ? board.size() : board.size() - 2;
+        remaining = rows;
     }
 
     /**
@@ -109,9 +269,12 @@ class MyDrain : public Drain<int, bool> {
 
         // workers have finished
         if (remaining == 0) {
-            remaining = board.size() - 2;
+            remaining = rows;
+            if (stats != nullptr)
+                stats->end_generation();
             swap(board, future);
-            print(board);
+            ck.tick(board);
+            render.submit(board);
             return true; // send feedback
         }
         return false;
@@ -6,38 +6,22 @@
 #include <queue>
 #include <thread>
 
+#include "../common/init.hpp"
+#include "../common/numa.hpp"
+#include "../common/options.hpp"
 #include "BLcode.cpp"
 #include "queue.cpp"
 
 using namespace std;
 
-int main(int argc, char* argv[]) {
-    if (argc < 6) {
-        cout << "Usage is " << argv[0]
-             << " rows cols generations seed nw" << endl;
-        return -1;
-    }
-
-    const size_t rows = atol(argv[1]);
-    const size_t cols = atol(argv[2]);
-    const unsigned long generations = atol(argv[3]);
-    const int seed = atoi(argv[4]);
-    const int nw = atoi(argv[5]);
-
-    // boards allocation
-    vector<vector<int>> board(rows, vector(cols, 0));
-    vector<vector<int>> future(rows, vector(cols, 0));
-
-    // board initialization
-    srand(seed);
-    for (size_t i = 1; i < board.size() - 1; ++i)
-        for (size_t j = 1; j < board[i].size() - 1; ++j)
-            board[i][j] = rand() % 2;
-
+template <typename BOARD, typename WORKER>
+long farm(BOARD &board, BOARD &future, WORKER f, unsigned long generations,
+          int nw, checkpointer &ck, bool torus = false,
+          const numa_layout *numa = nullptr, population *stats = nullptr) {
     // business logic code components
-    MySource s{board, 0, nw};
-    MyWorker f{board, future, 0};
-    MyDrain d{board, future, 0};
+    MySource s{board, 0, nw, torus};
+    renderer<BOARD> render(board);
+    MyDrain d{board, future, 0, ck, render, torus, stats};
 
     // implementing flow control
     const pair<int, int> EOS{-1, -1};
@@ -52,9 +36,10 @@ int main(int argc, char* argv[]) {
 
     // kind of three concurrent activities
     // place input tasks into the input queue
-    auto emit_task = [&](MySource s) {
-        int worker_n = 0;
+    auto emit_task = [&](MySource<BOARD> s) {
         for (unsigned long i = 0; i < generations; ++i) {
+            // chunk w to worker w, the owner of its rows
+            int worker_n = 0;
             while (s.hasNext()) {
                 auto t = s.next();
                 t_queue[worker_n].push(t);
@@ -65,6 +50,9 @@ int main(int argc, char* argv[]) {
                 s.feedback_notify();
             else
                 cout << "Impossible case" << endl;
+            // the drain has found a cycle
+            if (stats != nullptr && stats->stopped())
+                break;
         }
         // for as many workers to terminate, push EOS
         for (int i = 0; i < nw; i++)
@@ -73,7 +61,7 @@ int main(int argc, char* argv[]) {
     };
 
     // process results
-    auto proc_res = [&](MyDrain d, int nw) {
+    auto proc_res = [&](MyDrain<BOARD> d, int nw) {
         while (true) {
             auto t = r_queue.pop();
             if (t == EOS.first && (--nw) == 0)
@@ -84,7 +72,9 @@ int main(int argc, char* argv[]) {
     };
 
     // processing tasks to results in parallel
-    auto body = [&](MyWorker w, int wn) {
+    auto body = [&](WORKER w, int wn) {
+        if (numa != nullptr && !numa->pin(wn))
+            cout << "Failed pinning worker " << wn << endl;
         while (true) {
             auto t = t_queue[wn].pop();
             if (t == EOS) {
@@ -114,9 +104,262 @@ int main(int argc, char* argv[]) {
                        chrono::system_clock::now() - t0)
                        .count();
     delete[] t_queue;
+    return elapsed;
+}
+
+// NUMA mode: the workers, pinned, first-touch the rows they will compute
+// in both boards and, for a random board, draw their cells
+template <typename T>
+bool numa_init(Grid<T> &board, Grid<T> &future, const numa_layout &layout,
+               const string &load, int seed, bool torus, checkpointer &ck,
+               int nw, double density) {
+    const long b = torus ? 0 : 1;
+    const long rows = board.rows();
+    const bool random = !ck.resuming() && load.empty();
+    const cell_random rng(seed, density);
+
+    layout.run(rows, board.halo(), b, rows - b,
+               [&](int, long from, long to) {
+                   board.zero_rows(from, to);
+                   future.zero_rows(from, to);
+                   if (random)
+                       random_rows(board, rng, max(from, b),
+                                   min(to, rows - b), b);
+               });
+
+    if (random) {
+        if (torus)
+            board.wrap();
+        return true;
+    }
+    return ck.resuming() ? ck.restore(board, torus)
+                         : init_board(board, load, seed, torus, nw, density);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 6) {
+        cout << "Usage is " << argv[0]
+             << " rows cols generations seed nw"
+             << " [--engine=int|bits|lut|simd|tiled|ltl] [--torus]"
+             << " [--rule=B3/S23] [--kernel=direct|colsum]"
+             << " [--k=4 --tile-rows=64 --tile-cols=256]"
+             << " [--load=pattern] [--save=pattern] [--density=0.5]" << endl
+             << "[--checkpoint=file --checkpoint-every=1000 --compress]"
+             << " [--resume=file] [--numa] [--stats]"
+             << " [--cycle=8 [--extrapolate]]" << endl
+             << "[--record=file --keyframe-every=64]" << endl
+             << "with --engine=ltl the rule is Larger-than-Life, " << BOSCO
+             << " by default" << endl;
+        return -1;
+    }
+
+    const size_t rows = atol(argv[1]);
+    const size_t cols = atol(argv[2]);
+    const unsigned long generations = atol(argv[3]);
+    const int seed = atoi(argv[4]);
+    const int nw = atoi(argv[5]);
+    const options opts(argc, argv, 6);
+    const string engine = opts.get("engine", "int");
+    const bool torus = opts.has("torus");
+    const string load = opts.get("load", "");
+    const string save = opts.get("save", "");
+    const double density = atof(opts.get("density", "0.5").c_str());
+    if (engine != "int" && engine != "bits" && engine != "lut" &&
+        engine != "simd" && engine != "tiled" && engine != "ltl") {
+        cout << "Invalid engine " << engine << ", expected "
+             << "int|bits|lut|simd|tiled|ltl" << endl;
+        return -1;
+    }
+    checkpointer ck(opts, seed);
+    // Larger-than-Life rules for the ltl engine, B/S rules for the others
+    rule_spec rule = life::spec;
+    ltl_rule ltl;
+    if (engine == "ltl" ? !parse_ltl(opts.get("rule", BOSCO), ltl)
+                        : !parse_rule(opts.get("rule", "B3/S23"), rule)) {
+        cout << "Invalid rule " << opts.get("rule", "") << endl;
+        return -1;
+    }
+    bool colsum;
+    if (!parse_kernel(opts.get("kernel", "direct"), colsum)) {
+        cout << "Invalid kernel " << opts.get("kernel", "") << endl;
+        return -1;
+    }
+    const bool numa = opts.has("numa");
+    const numa_layout layout(nw);
+    const numa_layout *pinning = numa ? &layout : nullptr;
+    // live cells, births, deaths and bounding box of every generation,
+    // and/or a stop at the first cycle of period up to --cycle
+    population stats(nw, opts.has("stats"),
+                     cycle_detector(opts.get("cycle", 0L),
+                                    ck.remaining(generations),
+                                    opts.has("extrapolate")));
+    population *tracked = stats.enabled() ? &stats : nullptr;
+
+    if (torus && engine != "int" && engine != "simd") {
+        cout << "--torus is supported by the int and simd engines only"
+             << endl;
+        return -1;
+    }
+    if (rule != life::spec && engine != "int" && engine != "lut") {
+        cout << "--rule is supported by the int and lut engines only"
+             << endl;
+        return -1;
+    }
+    if (colsum && engine != "int") {
+        cout << "--kernel is supported by the int engine only" << endl;
+        return -1;
+    }
+    if (tracked != nullptr && engine != "int") {
+        cout << "--stats and --cycle are supported by the int engine only"
+             << endl;
+        return -1;
+    }
+    // temporal blocking of the tiled engine
+    const long k = opts.get("k", 4L);
+    const long tile_rows = opts.get("tile-rows", 64L);
+    const long tile_cols = opts.get("tile-cols", 256L);
+    if (engine == "tiled" && (k < 1 || tile_rows < 1 || tile_cols < 1)) {
+        cout << "--k, --tile-rows and --tile-cols must be positive" << endl;
+        return -1;
+    }
+    if (numa && (engine == "bits" || engine == "lut")) {
+        cout << "--numa is supported by the int, simd, tiled and ltl engines "
+                "only"
+             << endl;
+        return -1;
+    }
+
+    // checkpoint, pattern or random cells, on a torus there is no dead
+    // border; in NUMA mode the rows are first-touched by their workers
+    auto init = [&](auto &board, auto &future) {
+        if (!(numa ? numa_init(board, future, layout, load, seed, torus, ck,
+                               nw, density)
+                   : ck.resuming() ? ck.restore(board, torus)
+                                   : init_board(board, load, seed, torus, nw,
+                                                density)))
+            return false;
+        if (numa)
+            layout.report(board, torus ? 0 : 1,
+                          torus ? board.rows() : board.rows() - 1);
+        return true;
+    };
+
+    long elapsed;
+    if (engine == "bits" || engine == "lut") {
+        // 64 cells per word
+        bitboard board(rows, cols), future(rows, cols);
+
+        if (!(ck.resuming() ? ck.restore(board)
+                            : init_board(board, load, seed, nw, density)))
+            return -1;
+        ck.start(board);
+
+        if (engine == "lut") {
+            if (rule != life::spec)
+                cout << "Running " << rule.name() << endl;
+            const lut_kernel lut(rule, board.words());
+            elapsed = farm(board, future, MyLutWorker{board, future, 0, lut},
+                           ck.remaining(generations), nw, ck);
+        } else {
+            elapsed = farm(board, future, MyBitWorker{board, future, 0},
+                           ck.remaining(generations), nw, ck);
+        }
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    } else if (engine == "simd" || engine == "tiled") {
+        if (!row_kernels_self_check()) {
+            cout << "SIMD kernels disagree with the scalar path" << endl;
+            return -1;
+        }
+        cout << "Using the " << select_row_kernel().name << " row kernel"
+             << endl;
+
+        Grid<uint8_t> board(rows, cols, 1, !numa), future(rows, cols, 1, !numa);
+
+        if (!init(board, future))
+            return -1;
+        ck.start(board);
+
+        if (engine == "tiled") {
+            cout << "Advancing " << tile_rows << "x" << tile_cols
+                 << " tiles by " << k << " generations" << endl;
+
+            const unsigned long remaining = ck.remaining(generations);
+            ck.set_stride(k);
+            elapsed = farm(board, future,
+                           MyTiledWorker{board, future, 0, k,
+                                         tile_rows, tile_cols},
+                           remaining / k, nw, ck, false, pinning);
+            if (remaining % k != 0) {
+                ck.set_stride(remaining % k);
+                elapsed += farm(board, future,
+                                MyTiledWorker{board, future, 0,
+                                              long(remaining % k),
+                                              tile_rows, tile_cols},
+                                1, nw, ck, false, pinning);
+            }
+        } else {
+            elapsed = farm(board, future,
+                           MySimdWorker{board, future, 0, torus},
+                           ck.remaining(generations), nw, ck, torus,
+                           pinning);
+        }
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    } else if (engine == "ltl") {
+        Grid<int> board(rows, cols, 1, !numa), future(rows, cols, 1, !numa);
+
+        if (!init(board, future))
+            return -1;
+        ck.start(board);
+
+        if (!ltl_self_check(ltl)) {
+            cout << "Summed-area counts disagree with the direct count"
+                 << endl;
+            return -1;
+        }
+        cout << "Running " << ltl.name() << endl;
+        summed_area sat(rows, cols, ltl.r, 1, rows - 1);
+        sat.build(board, nw);
+        elapsed = farm(board, future, MyLtlWorker{board, future, 0, ltl, sat},
+                       ck.remaining(generations), nw, ck, false, pinning);
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, ltl))
+            return -1;
+    } else {
+        // boards allocation
+        Grid<int> board(rows, cols, 1, !numa), future(rows, cols, 1, !numa);
+
+        if (!init(board, future))
+            return -1;
+        ck.start(board);
+
+        if (colsum && !colsum_self_check<int>()) {
+            cout << "Column sums disagree with the direct count" << endl;
+            return -1;
+        }
+        if (rule != life::spec)
+            cout << "Running " << rule.name() << endl;
+        elapsed = with_rule(rule, [&](const auto &rule) {
+            return farm(board, future,
+                        MyWorker{board, future, 0, rule, torus, tracked,
+                                 colsum},
+                        ck.remaining(generations), nw, ck, torus, pinning,
+                        tracked);
+        });
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    }
 
-    cout << "Parallel execution with " << nw << " threads took " << elapsed
-         << " msecs" << endl;
+    cout << "Parallel execution (" << engine << ") with " << nw
+         << " threads took " << elapsed << " msecs" << endl;
         // << "speedup is " << ((float)tseq) / ((float)elapsed) << endl;
     return 0;
 }
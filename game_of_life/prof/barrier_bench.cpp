@@ -0,0 +1,73 @@
+//
+// barrier latency against the number of threads
+//
+// compile with
+// g++ -O3 -pthread barrier_bench.cpp -o barrier_bench
+//
+// every thread waits episodes times on the barrier, with nothing in
+// between, so the time per episode is the latency of the barrier itself;
+// for each number of threads all the barriers are tried with both wait
+// policies, sleeping on a futex and yielding after spins spins
+//
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <string>
+
+#include "../common/barrier.hpp"
+
+using namespace std;
+
+#define START(timename) auto timename = std::chrono::system_clock::now();
+#define STOP(timename,elapsed)  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - timename).count();
+
+// nsec per episode
+double latency(thread_barrier &b, int nw, long episodes) {
+  auto thr =
+    [&](int t) {
+      for(long e=0; e<episodes; e++)
+	b.wait(t);
+    };
+
+  START(start);
+  vector<thread> tids;
+  for(int t=0; t<nw; t++)
+    tids.emplace_back(thr, t);
+  for(auto &t : tids)
+    t.join();
+  STOP(start,elapsed);
+  return ((double) elapsed) / ((double) episodes);
+}
+
+int main(int argc, char * argv[]) {
+
+  if(argc < 3) {
+    cout << "Usage is: " << argv[0] << " max_nw episodes [spins]" << endl;
+    return(-1);
+  }
+  int max_nw = atoi(argv[1]);
+  long episodes = atol(argv[2]);
+  wait_policy policy;
+  if(argc > 3)
+    policy.spins = atoi(argv[3]);
+
+  const string kinds[] = {"central", "tree", "dissemination"};
+  cout << "nw";
+  for(auto &kind : kinds)
+    cout << "\t" << kind << "/futex\t" << kind << "/yield";
+  cout << "\t(nsec per episode)" << endl;
+
+  for(int nw=1; nw<=max_nw; nw++) {
+    cout << nw;
+    for(auto &kind : kinds)
+      for(bool futex : {true, false}) {
+	policy.futex = futex;
+	auto b = make_barrier(kind, nw, policy);
+	cout << "\t" << latency(*b, nw, episodes);
+      }
+    cout << endl;
+  }
+  return(0);
+}
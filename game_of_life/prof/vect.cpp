@@ -6,16 +6,28 @@
 // compile with -DCLASSIC for condition variable based barrier
 // by default we use the atomic based active wait barriers
 //
+// compile with -DREUSABLE to use a single reusable barrier of
+// ../common/barrier.hpp instead, central, tree or dissemination as
+// given by the 6th argument
+//
 // compile -DSEQ to see sequential run estimate before parallel run
 //
 // compile -DTRACETIMES to see all partial times
 //
+// compile -DSTATS to count live cells, births, deaths and bounding box
+// while updating y
+//
+// compile -DROLLING to compute y in place in a single pass, keeping the
+// old lines around the one being computed in a window of two lines per
+// thread instead of the whole e matrix: one barrier per iteration
+//
 
 #include <iostream>
 #include <vector>
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <cstring>
 
 // int or short int 
 #define INT  short int
@@ -29,7 +41,9 @@ std::mutex mut;
 
 using namespace std;
 
-#ifdef CLASSIC
+#ifdef REUSABLE
+#include "../common/barrier.hpp"
+#elif defined(CLASSIC)
 #include "Barrier.cpp"
 #else
 #include "abar.cpp"
@@ -39,7 +53,10 @@ using namespace std;
 #include "utimer.cpp"
 #endif
 
-void dumpw(vector< vector<INT>> a, int rows, int cols, bool print) {
+#include "../common/grid.hpp"
+#include "../common/stats.hpp"
+
+void dumpw(const Grid<INT> &a, int rows, int cols, bool print) {
   if(print) {
     for(int i=0; i<rows; i++) {
       for(int j=0; j<cols; j++)
@@ -53,7 +70,7 @@ void dumpw(vector< vector<INT>> a, int rows, int cols, bool print) {
   return;
 }
 
-void dumpe(vector< vector<INT>> a, int rows, int cols, bool print) {
+void dumpe(const Grid<INT> &a, int rows, int cols, bool print) {
   if(print) {
     for(int i=0; i<rows; i++) {
       for(int j=0; j<cols; j++)
@@ -67,42 +84,113 @@ void dumpe(vector< vector<INT>> a, int rows, int cols, bool print) {
   return;
 }
 
-void init1(vector<vector<INT>> &y, const int n, const int m, const int seed) {
+void init1(Grid<INT> &y, const int n, const int m, const int seed) {
   y[3][1]=1; y[3][2]=1; y[3][3]=1; y[2][3]=1; y[1][1]=1;
   return;
 }
 
-void fill_e(vector<vector<INT>> y, vector<vector<INT>> &e, const int n, const int m, const int from, const int to) {
+void fill_e(const Grid<INT> &y, Grid<INT> &e, const int n, const int m, const int from, const int to) {
   // compute just a portion of the matrix from line from to line to-1
-  for(int i=from; i<to; i++)
+  for(int i=from; i<to; i++) {
+    const INT *up = y[i-1], *mid = y[i], *down = y[i+1];
+    INT *ei = e[i];
 #pragma GCC ivdep // without : versioning
     for(int j=1; j<m-1; j++)
       {
 	// compute neighbourhood
-	e[i][j] = y[i-1][j-1] + y[i-1][j] + y[i-1][j+1] +
-	          y[i][j-1]               + y[i][j+1] +
-	          y[i+1][j-1] + y[i+1][j] + y[i+1][j+1];
+	ei[j] = up[j-1]   + up[j]   + up[j+1] +
+	        mid[j-1]            + mid[j+1] +
+	        down[j-1] + down[j] + down[j+1];
       }
+  }
   return;
 }
 
-void update_y(vector<vector<INT>> &y, vector<vector<INT>> e, const int n, const int m, const int from, const int to) {
+void update_y(Grid<INT> &y, const Grid<INT> &e, const int n, const int m, const int from, const int to) {
   // update just a portion of the matrix from line from to line to-1
-  for(int i=from; i<to; i++)
+  for(int i=from; i<to; i++) {
+    INT *yi = y[i];
+    const INT *ei = e[i];
 #pragma GCC ivdep  // without : versioning
     for(int j=1; j<m-1; j++)
-      y[i][j] = (e[i][j]==3) || (e[i][j]==2 && y[i][j]==1);
+      yi[j] = (ei[j]==3) || (ei[j]==2 && yi[j]==1);
+  }
   // 3 neighb (stay alive or new indidual) || 2 neighb and alive stay alive
   return;
 }
 
+void update_y(Grid<INT> &y, const Grid<INT> &e, const int, const int m, const int from, const int to, pop_stats &s) {
+  // same as above, counting the new cells against the old ones: sums in
+  // INT over blocks that cannot overflow it, or the loop vectorizes at half
+  // the width, then the ends of the live cells searched from both sides
+  const int block = 8192;
+  for(int i=from; i<to; i++) {
+    INT *yi = y[i];
+    const INT *ei = e[i];
+    long alive = 0, changed = 0, delta = 0;
+    for(int j0=1; j0<m-1; j0+=block) {
+      const int j1 = min(j0+block, m-1);
+      INT a = 0, x = 0, d = 0;
+#pragma GCC ivdep
+      for(int j=j0; j<j1; j++) {
+	const INT old = yi[j];
+	const INT cell = (ei[j]==3) || (ei[j]==2 && old==1);
+	yi[j] = cell;
+	a += cell;
+	x += cell ^ old;   // births + deaths
+	d += cell - old;   // births - deaths
+      }
+      alive += a; changed += x; delta += d;
+    }
+    int lo = 1, hi = m-2;
+    if(alive > 0) {
+      while(!yi[lo]) lo++;
+      while(!yi[hi]) hi--;
+    }
+    s.add_row(i, alive, (changed+delta)/2, (changed-delta)/2, lo, hi);
+  }
+  return;
+}
+
+// one pass over lines from to to-1 of y, in place: the old values of the
+// line being computed and of the one above it are saved in the rolling
+// window prev/cur, the next line is still old in y. above and below are
+// the old lines from-1 and to, owned by the neighbouring threads
+void step_y(Grid<INT> &y, const INT *above, const INT *below, INT *prev, INT *cur, const int m, const int from, const int to, pop_stats *s = nullptr) {
+  const INT *up = above;
+  memcpy(cur, y[from], m*sizeof(INT));
+  for(int i=from; i<to; i++) {
+    const INT *mid = cur, *down = (i+1 < to ? y[i+1] : below);
+    INT *yi = y[i];
+    auto next = [&](long j) {
+      const INT e = up[j-1]   + up[j]   + up[j+1] +
+	            mid[j-1]            + mid[j+1] +
+	            down[j-1] + down[j] + down[j+1];
+      // no short circuit, or the loop does not vectorize
+      return (INT) ((e==3) | ((e==2) & (mid[j]==1)));
+    };
+    if(s != nullptr)
+      s->sweep_row(i, mid, yi, 1, m-1, next);
+    else
+#pragma GCC ivdep
+      for(int j=1; j<m-1; j++)
+	yi[j] = next(j);
+    // line i becomes the one above, line i+1 is saved before computing it
+    swap(prev, cur);
+    up = prev;
+    if(i+1 < to)
+      memcpy(cur, y[i+1], m*sizeof(INT));
+  }
+  return;
+}
+
 #define START(timename) auto timename = std::chrono::system_clock::now();
 #define STOP(timename,elapsed)  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - timename).count();
 
 int main(int argc, char * argv[]) {
 
   if(argc==1) {
-    cout << "Usage is: " << argv[0] << " n m iter seed nw " << endl;
+    cout << "Usage is: " << argv[0] << " n m iter seed nw [barrier]" << endl;
     return(-1);
   }
   int n = atoi(argv[1]);
@@ -112,7 +200,10 @@ int main(int argc, char * argv[]) {
   int nw = atoi(argv[5]);
 
   std::cout << "Using " << sizeof(INT) << " byte(s) ints. ";
-#ifdef CLASSIC
+#ifdef REUSABLE
+  const string kind = argc > 6 ? argv[6] : "central";
+  std::cout << "Reusable " << kind << " barrier. ";
+#elif defined(CLASSIC)
   std::cout << "Barriers implemented using condition variables. ";
 #else
   std::cout << "Barriers implemented using atomic and active wait. ";
@@ -124,8 +215,10 @@ int main(int argc, char * argv[]) {
 #endif
   
   vector<INT> x(n);
-  vector< vector<INT> > y(n, vector<INT>(m));
-  vector< vector<INT> > e(n, vector<INT>(m));
+  Grid<INT> y(n, m);
+#ifndef ROLLING
+  Grid<INT> e(n, m);
+#endif
 
   const bool print = false; 
   const bool rnd = true; 
@@ -142,9 +235,16 @@ int main(int argc, char * argv[]) {
   long seqt;
   {
     START(start);
+#ifdef ROLLING
+    vector<INT> window(2*m);
+#endif
     for(int i=0; i<iter; i++) {
+#ifdef ROLLING
+      step_y(y,y[0],y[n-1],window.data(),window.data()+m,m,1,n-1);
+#else
       fill_e(y,e,n,m,1,n-1);
       update_y(y,e,n,m,1,n-1);
+#endif
     }
     STOP(start,elapsed);
     cout << "Seq    time:        " << ((float) elapsed)/((float) iter)
@@ -157,6 +257,14 @@ int main(int argc, char * argv[]) {
 #endif
 
   START(start);
+#ifdef REUSABLE
+  // the same barrier twice per iteration
+  auto sync = make_barrier(kind, nw);
+  if(!sync) {
+    cout << "Invalid barrier " << kind << endl;
+    return(-1);
+  }
+#else
 #ifdef CLASSIC
   vector<Barrier> vbf(iter), vbu(iter);
 #else
@@ -167,6 +275,19 @@ int main(int argc, char * argv[]) {
     b.set_t(nw);
   for(auto &b : vbu)
     b.set_t(nw);
+#endif
+#ifdef STATS
+  // one slot per thread, combined by thread 0 after each iteration; with
+  // ROLLING the others may already count the next one, in the other slots
+  population stats[2] = {population(nw), population(nw)};
+  pop_stats last;
+#endif
+#ifdef ROLLING
+  // first and last line of every thread, as they were at the beginning of
+  // iterations i (edges[i%2]) and i+1 (edges[1-i%2])
+  Grid<INT> edges(2*2*nw, m);
+  auto edge = [&](int p, int t, int last) { return edges[(p*nw + t)*2 + last]; };
+#endif
   
   auto thr =
     [&](int t) {
@@ -178,7 +299,37 @@ int main(int argc, char * argv[]) {
       auto li = (t==0 ? 1 : delta*t); // parte da 1 lasciando il bordo
       auto le  = (t == nw-1 ? n-1 : delta*(t+1));
       // cout << "Thread " << t << " computing rows from " << li << " to " << le-1 << endl; 
+#ifdef ROLLING
+      vector<INT> window(2*m);
+      memcpy(edge(0,t,0), y[li], m*sizeof(INT));
+      memcpy(edge(0,t,1), y[le-1], m*sizeof(INT));
+#ifdef REUSABLE
+      sync->wait(t);
+#else
+      vbf[0].BWait();
+#endif
+#endif
       for(int i=0; i<iter; i++) {
+#ifdef ROLLING
+	{
+#ifdef TRACETIMES
+	  utimer t0("b0",&temp);
+#endif
+	  const int p = i % 2;
+	  const INT *above = (t == 0 ? y[0] : edge(p,t-1,1));
+	  const INT *below = (t == nw-1 ? y[n-1] : edge(p,t+1,0));
+#ifdef STATS
+	  step_y(y,above,below,window.data(),window.data()+m,m,li,le,&stats[p].slot(t));
+#else
+	  step_y(y,above,below,window.data(),window.data()+m,m,li,le);
+#endif
+	  memcpy(edge(1-p,t,0), y[li], m*sizeof(INT));
+	  memcpy(edge(1-p,t,1), y[le-1], m*sizeof(INT));
+	}
+#ifdef TRACETIMES
+	us0+=temp;
+#endif
+#else
 	// cout << "Thread " << t << " computing e " << endl;
 	{
 #ifdef TRACETIMES
@@ -195,7 +346,11 @@ int main(int argc, char * argv[]) {
 #ifdef TRACETIMES
 	  utimer t1("b1",&temp);
 #endif
+#ifdef REUSABLE
+	  sync->wait(t);
+#else
 	  vbf[i].BWait();
+#endif
 	}
 #ifdef TRACETIMES
 	us1+=temp;
@@ -205,10 +360,15 @@ int main(int argc, char * argv[]) {
 #ifdef TRACETIMES
 	  utimer t2("b2",&temp);
 #endif
+#ifdef STATS
+	  update_y(y,e,n,m,li,le,stats[0].slot(t));
+#else
 	  update_y(y,e,n,m,li,le);
+#endif
 	}
 #ifdef TRACETIMES
 	us2+=temp;
+#endif
 #endif
 	// need to wait all other threads before starting new iteration
 	// cout << "Thread " << t << " barrier 2 ... " << endl;
@@ -216,11 +376,26 @@ int main(int argc, char * argv[]) {
 #ifdef TRACETIMES
 	  utimer t3("b3",&temp);
 #endif
+#ifdef REUSABLE
+	  sync->wait(t);
+#else
 	  vbu[i].BWait();
+#endif
 	}
 #ifdef TRACETIMES
 	us3+=temp;
 #endif
+#ifdef STATS
+	// nobody writes the slots again before thread 0 reaches the next
+	// barrier
+	if(t == 0) {
+#ifdef ROLLING
+	  last = stats[i % 2].combine();
+#else
+	  last = stats[0].combine();
+#endif
+	}
+#endif
 
 	if(print)
 	  if(t == 0)
@@ -230,10 +405,15 @@ int main(int argc, char * argv[]) {
       {
 	std::unique_lock<std::mutex> lk(mut);
 	
+#ifdef ROLLING
+	std::cout << "Avg one pass  " << ((float) us0)/((float) iter) << std::endl
+		  << "Avg barrier   " << ((float) us3)/((float) iter) << std::endl;
+#else
 	std::cout << "Avg neighbour " << ((float) us0)/((float) iter) << std::endl
 		  << "Avg barrier 1 " << ((float) us1)/((float) iter) << std::endl
 		  << "Avg newstate  " << ((float) us2)/((float) iter) << std::endl
 		  << "Avg barrier 2 " << ((float) us3)/((float) iter) << std::endl;
+#endif
       }
 #endif
     };
@@ -254,6 +434,9 @@ int main(int argc, char * argv[]) {
   cout << "Total time:        " << elapsed << " usec " 
        << "\twith\t" << nw << " threads\t"; 
   cout << "Average iteration: " << ((float) elapsed) / ((float) iter) <<endl;
+#ifdef STATS
+  cout << "Last iteration: " << last << endl;
+#endif
 #ifdef SEQ
   cout << "Achieved speedup is " << ((float) seqt)/((float) elapsed)
        << std::endl;
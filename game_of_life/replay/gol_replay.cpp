@@ -0,0 +1,60 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "../common/grid.hpp"
+#include "../common/options.hpp"
+#include "../common/patterns.hpp"
+#include "../common/record.hpp"
+#include "../common/render.hpp"
+#include "../common/rules.hpp"
+
+using namespace std;
+
+//
+// a generation of a --record recording: the keyframe at or before it is
+// decoded, then at most keyframe-every deltas
+//
+// compile with
+// g++ -O3 -pthread gol_replay.cpp -o gol_replay [-DGOL_MINIZ]
+//
+
+int main(int argc, char const *argv[]) {
+    if (argc < 3) {
+        cout << "Usage is " << argv[0] << " recording generation"
+             << " [--save=pattern] [--print]" << endl;
+        return -1;
+    }
+
+    const string path = argv[1];
+    const unsigned long generation = atol(argv[2]);
+    const options opts(argc, argv, 3);
+
+    replay rec(path);
+    if (!rec.ok())
+        return -1;
+    cout << path << ": " << rec.rows() << "x" << rec.cols() << ", seed "
+         << rec.seed() << ", keyframe every " << rec.keyframe_every()
+         << ", from generation " << rec.first_generation() << endl;
+
+    Grid<uint8_t> board(rec.rows(), rec.cols());
+    if (!rec.seek(generation, board))
+        return -1;
+
+    unsigned long alive = 0;
+    for (long i = 0; i < board.rows(); ++i)
+        for (long j = 0; j < board.cols(); ++j)
+            alive += board[i][j];
+    cout << "Generation " << generation << ": " << alive << " alive"
+         << endl;
+
+    if (opts.has("print")) {
+        renderer<Grid<uint8_t>> render(board);
+        render.submit(board);
+    }
+    // recordings do not keep the rule, the pattern is written as Life
+    if (opts.has("save") &&
+        !save_pattern(opts.get("save", ""), board, life::spec))
+        return -1;
+    return 0;
+}
@@ -2,39 +2,58 @@
 #include <thread>
 #include <vector>
 
+#include "../common/bitboard.hpp"
+#include "../common/checkpoint.hpp"
+#include "../common/grid.hpp"
+#include "../common/init.hpp"
+#include "../common/lut.hpp"
+#include "../common/options.hpp"
+#include "../common/rules.hpp"
+
 using namespace std;
 
 using INT = short int;
 
-INT compute_future(INT alive, INT alive_neighbours) {
-    if (alive_neighbours < 2 || alive_neighbours > 3)
-        return 0;
-    else if (alive_neighbours == 3)
-        return 1;
-    else
-        return alive;
-}
-
-void update(const vector<vector<INT>> &board, vector<vector<INT>> &future) {
-    for (size_t i = 1; i < board.size() - 1; ++i) {
-        #pragma GCC ivdep
-        for (size_t j = 1; j < board[i].size() - 1; ++j) {
+// with torus the whole board is computed and the halo mirrors the
+// opposite edges, otherwise the outer rows and columns stay dead
+template <typename RULE>
+void update(const Grid<INT> &board, Grid<INT> &future, bool torus,
+            const RULE &rule) {
+    const long b = torus ? 0 : 1;
+    for (long i = b; i < board.rows() - b; ++i) {
+        const INT *up = board[i - 1], *mid = board[i], *down = board[i + 1];
+        // restrict instead of ivdep, which GCC drops in templates
+        INT *__restrict out = future[i];
+        for (long j = b; j < board.cols() - b; ++j) {
             INT alive_neighbours =
-                board[i - 1][j - 1] + board[i - 1][j] + board[i - 1][j + 1] +
-                board[i][j - 1] + board[i][j + 1] +
-                board[i + 1][j - 1] + board[i + 1][j] + board[i + 1][j + 1];
-            future[i][j] = compute_future(board[i][j], alive_neighbours);
+                up[j - 1] + up[j] + up[j + 1] +
+                mid[j - 1] + mid[j + 1] +
+                down[j - 1] + down[j] + down[j + 1];
+            out[j] = rule.next(mid[j], alive_neighbours);
         }
+        if (torus)
+            future.wrap_row(i);
     }
 }
 
-void print(const vector<vector<INT>> &board) {
-    string border(board[0].size() + 2, '-');
+// B3/S23 only
+void update(const bitboard &board, bitboard &future, bool, const life &) {
+    board.step(future, 1, board.rows() - 1);
+}
+
+// any rule, through the table of the kernel
+void update(const bitboard &board, bitboard &future, bool,
+            const lut_kernel &lut) {
+    lut.step(board, future, 1, board.rows() - 1);
+}
+
+void print(const Grid<INT> &board) {
+    string border(board.cols() + 2, '-');
 
     cout << border << endl;
-    for (size_t i = 0; i < board.size(); ++i) {
+    for (long i = 0; i < board.rows(); ++i) {
         cout << '|';
-        for (size_t j = 0; j < board[i].size(); ++j)
+        for (long j = 0; j < board.cols(); ++j)
             cout << (board[i][j] ? '*' : ' ');
         cout << '|' << endl;
     }
@@ -42,10 +61,33 @@ void print(const vector<vector<INT>> &board) {
     this_thread::sleep_for(chrono::milliseconds(50));
 }
 
+template <typename BOARD, typename RULE>
+long simulate(BOARD &board, BOARD &future, unsigned long generations,
+              bool torus, checkpointer &ck, const RULE &rule) {
+    auto t0 = chrono::system_clock::now();
+    for (unsigned long it = 0; it < generations; ++it) {
+        update(board, future, torus, rule);
+        swap(board, future);
+        ck.tick(board);
+
+        /* cout << string(20, '\n'); // "clear" the screen
+        cout << it + 1 << "/" << generations << endl;
+        print(board); */
+    }
+    return chrono::duration_cast<chrono::milliseconds>(
+               chrono::system_clock::now() - t0)
+        .count();
+}
+
 int main(int argc, char const *argv[]) {
     if (argc < 5) {
         cout << "Usage is " << argv[0]
-             << " rows cols generations seed" << endl;
+             << " rows cols generations seed [--engine=int|bits|lut] [--torus]"
+             << " [--rule=B3/S23]"
+             << " [--load=pattern] [--save=pattern] [--density=0.5]" << endl
+             << "[--checkpoint=file --checkpoint-every=1000 --compress]"
+             << " [--resume=file]"
+             << endl << "[--record=file --keyframe-every=64]" << endl;
         return -1;
     }
 
@@ -53,33 +95,81 @@ int main(int argc, char const *argv[]) {
     const size_t cols = atol(argv[2]);
     const unsigned long generations = atol(argv[3]);
     const int seed = atoi(argv[4]);
+    const options opts(argc, argv, 5);
+    const string engine = opts.get("engine", "int");
+    const bool torus = opts.has("torus");
+    const string load = opts.get("load", "");
+    const string save = opts.get("save", "");
+    const double density = atof(opts.get("density", "0.5").c_str());
+    if (engine != "int" && engine != "bits" && engine != "lut") {
+        cout << "Invalid engine " << engine << ", expected int|bits|lut"
+             << endl;
+        return -1;
+    }
+    checkpointer ck(opts, seed);
+    rule_spec rule;
+    if (!parse_rule(opts.get("rule", "B3/S23"), rule)) {
+        cout << "Invalid rule " << opts.get("rule", "") << endl;
+        return -1;
+    }
 
-    // boards allocation
-    vector<vector<INT>> board(rows);
-    vector<vector<INT>> future(rows);
-    for (auto &v : board)
-        v = vector<INT>(cols);
-    for (auto &v : future)
-        v = vector<INT>(cols);
-
-    // board initialization
-    srand(seed);
-    for (size_t i = 1; i < board.size() - 1; ++i)
-        for (size_t j = 1; j < board[i].size() - 1; ++j)
-            board[i][j] = rand() % 2;
-    
-    auto t0 = chrono::system_clock::now();
-    for (unsigned long it = 0; it < generations; ++it) {
-        update(board, future);
-        board.swap(future);
+    long elapsed;
+    if (torus && engine != "int") {
+        cout << "--torus is supported by the int engine only" << endl;
+        return -1;
+    }
+    if (rule != life::spec && engine != "int" && engine != "lut") {
+        cout << "--rule is supported by the int and lut engines only"
+             << endl;
+        return -1;
+    }
+    if (engine == "bits" || engine == "lut") {
+        // 64 cells per word
+        bitboard board(rows, cols), future(rows, cols);
 
-        /* cout << string(20, '\n'); // "clear" the screen
-        cout << it + 1 << "/" << generations << endl;
-        print(board); */
+        if (!(ck.resuming() ? ck.restore(board)
+                            : init_board(board, load, seed, 1, density)))
+            return -1;
+        ck.start(board);
+
+        if (engine == "lut") {
+            // 2x2 blocks from a table built for the rule
+            if (rule != life::spec)
+                cout << "Running " << rule.name() << endl;
+            const lut_kernel lut(rule, board.words());
+            elapsed = simulate(board, future, ck.remaining(generations),
+                               torus, ck, lut);
+        } else {
+            elapsed = simulate(board, future, ck.remaining(generations),
+                               torus, ck, life{});
+        }
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
+    } else {
+        // boards allocation
+        Grid<INT> board(rows, cols, 1), future(rows, cols, 1);
+
+        // checkpoint, pattern or random cells, on a torus there is no dead
+        // border
+        if (!(ck.resuming() ? ck.restore(board, torus)
+                            : init_board(board, load, seed, torus, 1, density)))
+            return -1;
+        ck.start(board);
+
+        if (rule != life::spec)
+            cout << "Running " << rule.name() << endl;
+        elapsed = with_rule(rule, [&](const auto &rule) {
+            return simulate(board, future, ck.remaining(generations), torus,
+                            ck, rule);
+        });
+
+        ck.finish(board);
+        if (!save.empty() && !save_pattern(save, board, rule))
+            return -1;
     }
-    auto elapsed = chrono::duration_cast<chrono::milliseconds>(
-                       chrono::system_clock::now() - t0)
-                       .count();
-    cout << "Sequential execution took " << elapsed << " msecs" << endl;
+    cout << "Sequential execution (" << engine << ") took " << elapsed
+         << " msecs" << endl;
     return 0;
 }